@@ -1,4 +1,8 @@
 #include <Beeton.h>
+// IDs generated from the mapping CSVs by tools/beeton_catalogue.py
+#include "BeetonCatalogue.h"
+
+using namespace BeetonIds;
 
 LightThread lightThread;
 Beeton beeton;
@@ -11,14 +15,6 @@ const int LONG_PRESS_TIME = 500;
 
 bool sentStop = false;
 
-// Cached Beeton IDs
-uint16_t trainThing = 0;
-uint8_t stopAction = 0;
-uint8_t coastAction = 0;
-uint8_t setSpeedAction = 0;
-
-bool mappingsReady = false;
-
 void setup() {
     Serial.begin(115200);
     delay(1000);
@@ -30,37 +26,10 @@ void setup() {
     pinMode(GPIO_NUM_0, INPUT);
     
     analogReadResolution(8);
-
-    if(!beeton.getThingId("train", trainThing)) {
-        Serial.println("ERROR: thing 'train' not found");
-        return;
-    }
-
-    if(!beeton.getActionId("train", "stop", stopAction)) {
-        Serial.println("ERROR: action 'train.stop' not found");
-        return;
-    }
-
-    if(!beeton.getActionId("train", "coast", coastAction)) {
-        Serial.println("ERROR: action 'train.coast' not found");
-        return;
-    }
-
-    if(!beeton.getActionId("train", "setspeed", setSpeedAction)) {
-        Serial.println("ERROR: action 'train.setspeed' not found");
-        return;
-    }
-
-    mappingsReady = true;
-
 }
 
 void loop() {
     beeton.update();
-    if(!mappingsReady){
-      delay(10);
-      return;
-    }
 
     if(lightThread.isReady()){
       
@@ -72,7 +41,7 @@ void loop() {
       else if(oldButtonState == true && buttonState == true && !sentStop){
         if(millis()-pressedTime  > LONG_PRESS_TIME){
           Serial.println("stop");
-          beeton.send(true,trainThing,1,stopAction);
+          beeton.send(true,train::STOP,1,{},BEETON_PRIORITY_URGENT);
       
           sentStop = true;
         }
@@ -80,7 +49,7 @@ void loop() {
       else if(oldButtonState == true && buttonState == false){
         if(!sentStop){
           Serial.println("coast");
-          beeton.send(true,trainThing,1,coastAction);
+          beeton.send(true,train::COAST,1);
       
         }      
       }
@@ -91,7 +60,7 @@ void loop() {
       if(abs(newKnobPos-oldKnobPos) > 10){
         Serial.printf("knobpos: %d\n",newKnobPos);
         oldKnobPos = newKnobPos;
-        beeton.send(false,trainThing,1,setSpeedAction,(uint8_t) newKnobPos);
+        beeton.sendState(train::SETSPEED,1,(uint8_t) newKnobPos);
       }
     }
     delay(10);
@@ -26,11 +26,11 @@ void setup() {
     beeton.begin(lightThread);
 
     // Handle only user-defined actions
-    beeton.onMessage([](uint16_t thingId, uint8_t id, uint8_t actionId, const std::vector<uint8_t>& payload) {
-        String thing = beeton.getThingName(thingId);
-        String action = beeton.getActionName(thing, actionId);
-        if (thing == "train"){
-          if (action == "setspeed" && payload.size() == 1) {
+    beeton.onMessage([](uint16_t thingId, uint8_t id, uint8_t actionId, const BeetonPayloadView& payload) {
+        const char *thing = beeton.getThingName(thingId);
+        const char *action = beeton.getActionName(thingId, actionId);
+        if (strcmp(thing, "train") == 0){
+          if (strcmp(action, "setspeed") == 0 && payload.size() == 1) {
             int speed = payload[0]*2 - 255;
             Serial.println(speed);
             if(speed >=0){
@@ -42,13 +42,13 @@ void setup() {
               ledcWrite(IN2, abs(speed));
             }
           } 
-          if (action == "coast"){
+          if (strcmp(action, "coast") == 0){
             Serial.println("coasting");
             ledcWrite(IN1, 0);
             ledcWrite(IN2, 0);
 
           }
-          if(action == "stop"){
+          if(strcmp(action, "stop") == 0){
             Serial.println("stopping");
             ledcWrite(IN1, 255);
             ledcWrite(IN2, 255);
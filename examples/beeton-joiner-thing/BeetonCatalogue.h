@@ -0,0 +1,58 @@
+#pragma once
+// Generated by tools/beeton_catalogue.py from all_things.csv, all_actions.csv, all_groups.csv.
+// Do not edit; regenerate when the CSVs change.
+
+#include <Beeton.h>
+
+namespace BeetonIds {
+
+namespace train {
+constexpr uint16_t THING = 1;
+constexpr BeetonActionId SETSPEED{THING, 1};
+constexpr BeetonActionId COAST{THING, 2};
+constexpr BeetonActionId STOP{THING, 3};
+} // namespace train
+
+namespace signal {
+constexpr uint16_t THING = 2;
+constexpr BeetonActionId SETRED{THING, 1};
+constexpr BeetonActionId SETGREEN{THING, 2};
+} // namespace signal
+
+namespace groups {
+constexpr uint16_t ALL_TRAINS = 1;
+constexpr uint16_t ALL_SIGNALS = 2;
+} // namespace groups
+
+constexpr BeetonCatalogueThing THINGS[] = {
+    {1, "train"},
+    {2, "signal"},
+};
+
+constexpr BeetonCatalogueAction ACTIONS[] = {
+    {{1, 1}, "setspeed"},
+    {{1, 2}, "coast"},
+    {{1, 3}, "stop"},
+    {{2, 1}, "setred"},
+    {{2, 2}, "setgreen"},
+};
+
+constexpr const char *thingName(uint16_t thing) {
+    for(const BeetonCatalogueThing &entry : THINGS) {
+        if(entry.thing == thing) {
+            return entry.name;
+        }
+    }
+    return "unknown";
+}
+
+constexpr const char *actionName(uint16_t thing, uint8_t action) {
+    for(const BeetonCatalogueAction &entry : ACTIONS) {
+        if(entry.action.is(thing, action)) {
+            return entry.name;
+        }
+    }
+    return "unknown";
+}
+
+} // namespace BeetonIds
@@ -1,4 +1,8 @@
 #include <Beeton.h>
+// IDs generated from the mapping CSVs by tools/beeton_catalogue.py
+#include "BeetonCatalogue.h"
+
+using namespace BeetonIds;
 
 LightThread lightThread;
 Beeton beeton;
@@ -9,6 +13,34 @@ const int IN2 = GPIO_NUM_23;
 const uint32_t frequency = 20000;
 const uint8_t resolution = 8;
 
+void setSpeed(void *, uint16_t, uint8_t, uint8_t, const BeetonPayloadView &payload) {
+    if(payload.size() != 1) {
+        return;
+    }
+    int speed = payload[0]*2 - 255;
+    Serial.println(speed);
+    if(speed >=0){
+      ledcWrite(IN1, speed);
+      ledcWrite(IN2, 0);
+    }
+    else{
+      ledcWrite(IN1,0);
+      ledcWrite(IN2, abs(speed));
+    }
+}
+
+void coast(void *, uint16_t, uint8_t, uint8_t, const BeetonPayloadView &) {
+    Serial.println("coasting");
+    ledcWrite(IN1, 0);
+    ledcWrite(IN2, 0);
+}
+
+void stop(void *, uint16_t, uint8_t, uint8_t, const BeetonPayloadView &) {
+    Serial.println("stopping");
+    ledcWrite(IN1, 255);
+    ledcWrite(IN2, 255);
+}
+
 void setup() {
     Serial.begin(115200);
     delay(1000);
@@ -19,35 +51,14 @@ void setup() {
     lightThread.begin();
     beeton.begin(lightThread);
 
-    // Handle only user-defined actions
-    beeton.onMessage([](uint16_t thingId, uint8_t id, uint8_t actionId, const std::vector<uint8_t>& payload) {
-        String thing = beeton.getThingName(thingId);
-        String action = beeton.getActionName(thing, actionId);
-        if (thing == "train"){
-          if (action == "setspeed" && payload.size() == 1) {
-            int speed = payload[0]*2 - 255;
-            Serial.println(speed);
-            if(speed >=0){
-              ledcWrite(IN1, speed);
-              ledcWrite(IN2, 0);
-            }
-            else{
-              ledcWrite(IN1,0);
-              ledcWrite(IN2, abs(speed));
-            }
-          } 
-          if (action == "coast"){
-            Serial.println("coasting");
-            ledcWrite(IN1, 0);
-            ledcWrite(IN2, 0);
-
-          }
-          if(action == "stop"){
-            Serial.println("stopping");
-            ledcWrite(IN1, 255);
-            ledcWrite(IN2, 255);
-          }
-        } 
+    // One handler per action of train 1, found with a single table lookup
+    beeton.onAction(train::SETSPEED, 1, setSpeed);
+    beeton.onAction(train::COAST, 1, coast);
+    beeton.onAction(train::STOP, 1, stop);
+
+    // Anything else that reaches this node
+    beeton.onMessage([](uint16_t thingId, uint8_t id, uint8_t actionId, const BeetonPayloadView& payload) {
+        Serial.printf("unhandled %s.%s id=%u\n", thingName(thingId), actionName(thingId, actionId), id);
     });
 }
 
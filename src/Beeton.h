@@ -3,27 +3,235 @@
 
 #include <Arduino.h>
 #include <LightThread.h>
+#include <deque>
 #include <functional>
 #include <map>
+#include <unordered_map>
 #include <vector>
 
 #include "BeetonConfig.h"
+#include "BeetonFlatMap.h"
+#include "BeetonFraming.h"
+#include "BeetonMappingIndex.h"
+#include "BeetonPool.h"
+#include "BeetonSymbols.h"
 
 
 
 
 
+enum BeetonAckMode {
+    BEETON_ACK_IMMEDIATE, // one ACK frame per reliable packet
+    BEETON_ACK_DELAYED    // one selective ACK per origin after a short delay
+};
+
+enum BeetonDeliveryMode {
+    BEETON_DELIVERY_HOP_BY_HOP, // the next hop ACKs: lowest latency
+    BEETON_DELIVERY_END_TO_END  // only the owning node ACKs, relayed back by the leader
+};
+
+// Transmit classes, highest first. Urgent frames are never queued; normal
+// and bulk wait their turn once the per-update budget is used up.
+enum BeetonPriority {
+    BEETON_PRIORITY_URGENT,
+    BEETON_PRIORITY_NORMAL,
+    BEETON_PRIORITY_BULK,
+    BEETON_PRIORITY_COUNT
+};
+
+enum BeetonSendResult {
+    BEETON_SEND_OK,         // sent, batched or queued for transmit
+    BEETON_SEND_DEFERRED,   // reliable, held until the destination's window opens
+    BEETON_SEND_QUEUE_FULL, // nothing accepted, try again later
+    BEETON_SEND_NOT_READY,
+    BEETON_SEND_NO_ROUTE,
+    BEETON_SEND_FAILED,     // the transport refused the frame
+    BEETON_SEND_NO_MEMORY   // pending or frame pool exhausted, or frame too large
+};
+
 enum BeetonLogLevel { BEETON_LOG_DEBUG, BEETON_LOG_INFO, BEETON_LOG_WARN, BEETON_LOG_ERROR };
 
-struct BeetonPacket {
-    uint8_t version = 0;
-    String originIp;
-    uint8_t flags = 0;
-    uint16_t seq = 0;
-    uint16_t thing = 0;
-    uint8_t id = 0;
-    uint8_t action = 0;
-    std::vector<uint8_t> payload;
+// Fixed-size binary mesh address. Used internally for routing, dedupe and
+// retries; converted to text only when handed to LightThread or USB.
+struct BeetonAddress {
+    uint8_t bytes[BEETON_ORIGIN_IP_SIZE] = {0};
+
+    static BeetonAddress fromBytes(const uint8_t *data) {
+        BeetonAddress addr;
+        memcpy(addr.bytes, data, BEETON_ORIGIN_IP_SIZE);
+        return addr;
+    }
+
+    bool isUnspecified() const {
+        for(size_t i = 0; i < BEETON_ORIGIN_IP_SIZE; i++) {
+            if(bytes[i] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator==(const BeetonAddress &other) const {
+        return memcmp(bytes, other.bytes, BEETON_ORIGIN_IP_SIZE) == 0;
+    }
+    bool operator!=(const BeetonAddress &other) const { return !(*this == other); }
+    bool operator<(const BeetonAddress &other) const {
+        return memcmp(bytes, other.bytes, BEETON_ORIGIN_IP_SIZE) < 0;
+    }
+};
+
+// Mesh-local EIDs end in a random 64-bit interface identifier, so its low
+// word is already a well-spread hash.
+struct BeetonAddressHash {
+    size_t operator()(const BeetonAddress &addr) const {
+        uint32_t h;
+        memcpy(&h, addr.bytes + BEETON_ORIGIN_IP_SIZE - sizeof(h), sizeof(h));
+        return h;
+    }
+};
+
+// Read-only span over the payload bytes of a received frame
+struct BeetonPayloadView {
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+
+    const uint8_t *data() const { return bytes; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const uint8_t *begin() const { return bytes; }
+    const uint8_t *end() const { return bytes + length; }
+    uint8_t operator[](size_t i) const { return bytes[i]; }
+};
+
+// Non-owning view over a raw v1 or compact frame. Header fields are decoded
+// on parse and the payload points into the buffer, which must outlive the
+// view. A compact frame only carries a short origin; the receiver resolves
+// it with setOrigin() before the view is used.
+class BeetonPacketView {
+  public:
+    bool parse(const uint8_t *data, size_t length) {
+        if(!data || length < BEETON_COMPACT_HEADER_SIZE) {
+            return false;
+        }
+        bytes = data;
+        size = length;
+
+        if(data[BEETON_OFFSET_VERSION] == BEETON_PROTOCOL_VERSION_COMPACT) {
+            originShortValue = readBe16(data + BEETON_COMPACT_OFFSET_ORIGIN);
+            epochValue = data[BEETON_COMPACT_OFFSET_EPOCH];
+            originAddress = BeetonAddress();
+            flagsValue = data[BEETON_COMPACT_OFFSET_FLAGS];
+            seqValue = readBe16(data + BEETON_COMPACT_OFFSET_SEQ);
+            thingValue = readBe16(data + BEETON_COMPACT_OFFSET_THING);
+            idValue = data[BEETON_COMPACT_OFFSET_ID];
+            actionValue = data[BEETON_COMPACT_OFFSET_ACTION];
+            body = {data + BEETON_COMPACT_HEADER_SIZE, length - BEETON_COMPACT_HEADER_SIZE};
+            return true;
+        }
+
+        if(length < BEETON_HEADER_SIZE) {
+            return false;
+        }
+        originShortValue = BEETON_SHORT_ADDRESS_NONE;
+        epochValue = 0;
+        originAddress = BeetonAddress::fromBytes(data + BEETON_OFFSET_ORIGIN);
+        flagsValue = data[BEETON_OFFSET_FLAGS];
+        seqValue = readBe16(data + BEETON_OFFSET_SEQ);
+        thingValue = readBe16(data + BEETON_OFFSET_THING);
+        idValue = data[BEETON_OFFSET_ID];
+        actionValue = data[BEETON_OFFSET_ACTION];
+        body = {data + BEETON_HEADER_SIZE, length - BEETON_HEADER_SIZE};
+        return true;
+    }
+
+    // Steps through the records of a BATCH frame. Each record is returned as
+    // a view sharing this frame's origin, flags and seq; raw() still refers
+    // to the whole frame.
+    bool nextRecord(size_t &offset, BeetonPacketView &record) const {
+        if(offset + BEETON_BATCH_RECORD_HEADER_SIZE > body.size()) {
+            return false;
+        }
+        const uint8_t *r = body.data() + offset;
+        size_t len = r[4];
+        if(offset + BEETON_BATCH_RECORD_HEADER_SIZE + len > body.size()) {
+            return false;
+        }
+        record = *this;
+        record.thingValue = readBe16(r);
+        record.idValue = r[2];
+        record.actionValue = r[3];
+        record.body = {r + BEETON_BATCH_RECORD_HEADER_SIZE, len};
+        offset += BEETON_BATCH_RECORD_HEADER_SIZE + len;
+        return true;
+    }
+
+    const uint8_t *raw() const { return bytes; }
+    size_t rawSize() const { return size; }
+
+    uint8_t version() const { return bytes[BEETON_OFFSET_VERSION]; }
+    bool compact() const { return originShortValue != BEETON_SHORT_ADDRESS_NONE; }
+    uint16_t originShort() const { return originShortValue; }
+    uint8_t originEpoch() const { return epochValue; }
+    void setOrigin(const BeetonAddress &addr) { originAddress = addr; }
+    const uint8_t *originBytes() const { return originAddress.bytes; }
+    const BeetonAddress &origin() const { return originAddress; }
+    uint8_t flags() const { return flagsValue; }
+    uint16_t seq() const { return seqValue; }
+    uint16_t thing() const { return thingValue; }
+    uint8_t id() const { return idValue; }
+    uint8_t action() const { return actionValue; }
+    BeetonPayloadView payload() const { return body; }
+
+  private:
+    const uint8_t *bytes = nullptr;
+    size_t size = 0;
+    uint16_t originShortValue = BEETON_SHORT_ADDRESS_NONE;
+    uint8_t epochValue = 0;
+    BeetonAddress originAddress;
+    uint8_t flagsValue = 0;
+    uint16_t seqValue = 0;
+    uint16_t thingValue = 0;
+    uint8_t idValue = 0;
+    uint8_t actionValue = 0;
+    BeetonPayloadView body;
+
+    static uint16_t readBe16(const uint8_t *p) {
+        return (uint16_t(p[0]) << 8) | uint16_t(p[1]);
+    }
+};
+
+// Running counters, readable through Beeton::getStats()
+// Per transmit class. Latency is time spent queued inside Beeton.
+struct BeetonTxClassStats {
+    uint32_t sentFrames = 0;
+    uint32_t droppedFrames = 0; // class queue was full
+    uint16_t queueDepth = 0;
+    uint16_t maxQueueDepth = 0;
+    uint32_t totalLatencyMs = 0;
+    uint32_t maxLatencyMs = 0;
+};
+
+struct BeetonStats {
+    uint32_t retransmittedFrames = 0;
+    uint32_t retransmittedBytes = 0;
+    uint32_t forwardedFrames = 0;
+    uint32_t supersededFrames = 0; // state values replaced before they were ACKed or sent
+    BeetonTxClassStats tx[BEETON_PRIORITY_COUNT];
+    uint32_t pendingPoolExhausted = 0;
+    uint32_t framePoolExhausted = 0;
+};
+
+#ifdef BEETON_COUNT_ALLOCATIONS
+// Global operator new calls since boot, for asserting heap-free paths in tests
+uint32_t beetonAllocationCount();
+#endif
+
+// Smoothed round-trip estimate for one next-hop destination (RFC 6298 style)
+struct BeetonRttEstimate {
+    uint32_t srttMs = 0;
+    uint32_t rttvarMs = 0;
+    uint32_t rtoMs = BEETON_RETRY_INTERVAL_MS;
+    uint32_t samples = 0;
 };
 
 struct BeetonThing {
@@ -31,6 +239,38 @@ struct BeetonThing {
     uint8_t id;
 };
 
+// A thing's action as one compile-time value, as emitted by
+// tools/beeton_catalogue.py. Carrying the thing means an action can't be
+// sent to the wrong kind of thing.
+struct BeetonActionId {
+    uint16_t thing;
+    uint8_t action;
+
+    constexpr bool is(uint16_t t, uint8_t a) const { return thing == t && action == a; }
+};
+
+// Name table rows in a generated catalogue
+struct BeetonCatalogueThing {
+    uint16_t thing;
+    const char *name;
+};
+struct BeetonCatalogueAction {
+    BeetonActionId action;
+    const char *name;
+};
+
+// What reloadMappings() changed. A renamed entry kept its ID.
+struct BeetonMappingChanges {
+    uint16_t thingsAdded = 0;
+    uint16_t thingsRemoved = 0;
+    uint16_t thingsRenamed = 0;
+    uint16_t actionsAdded = 0;
+    uint16_t actionsRemoved = 0;
+    uint16_t actionsRenamed = 0;
+    uint16_t groupsChanged = 0;
+    bool definesChanged = false;
+};
+
 class Beeton {
   public:
 
@@ -44,12 +284,79 @@ class Beeton {
     bool send(bool reliable, uint16_t thing, uint8_t id, uint8_t action);
     bool send(bool reliable, uint16_t thing, uint8_t id, uint8_t action, uint8_t payloadByte);
     bool send(bool reliable, uint16_t thing, uint8_t id, uint8_t action,
-              const std::vector<uint8_t> &payload);
+              const std::vector<uint8_t> &payload,
+              BeetonPriority priority = BEETON_PRIORITY_NORMAL);
+
+    // Non-blocking send that says why a message was not accepted. send()
+    // is this reduced to accepted / not accepted.
+    BeetonSendResult trySend(bool reliable, uint16_t thing, uint8_t id, uint8_t action,
+                             const std::vector<uint8_t> &payload,
+                             BeetonPriority priority = BEETON_PRIORITY_NORMAL);
+
+    // Per next hop: at most window reliable messages in flight (0 = no
+    // limit) and maxHeld more waiting for a slot. Urgent sends skip the wait.
+    void setFlowControl(uint8_t window, uint8_t maxHeld = BEETON_FLOW_HELD_MAX);
+
+    // Credit this node advertises in its ACKs; senders shrink their window
+    // to it. BEETON_CREDIT_UNADVERTISED turns it off.
+    void setAdvertisedCredit(uint8_t credit) { advertisedCredit = credit; }
+
+    // State-style send for values such as speed: always reliable, and the
+    // newest value for thing/id/action replaces any queued or unacknowledged
+    // one, so retries never replay a stale value. A superseded send fires
+    // neither ACK callback. If the new value cannot be sent or held, the old
+    // one stays in flight and false is returned.
+    bool sendState(uint16_t thing, uint8_t id, uint8_t action, uint8_t payloadByte,
+                   BeetonPriority priority = BEETON_PRIORITY_NORMAL);
+    bool sendState(uint16_t thing, uint8_t id, uint8_t action, const std::vector<uint8_t> &payload,
+                   BeetonPriority priority = BEETON_PRIORITY_NORMAL);
+
+    // The same sends with catalogue IDs from tools/beeton_catalogue.py, e.g.
+    // send(true, BeetonIds::train::STOP, 1). id is still the instance.
+    bool send(bool reliable, BeetonActionId action, uint8_t id, uint8_t payloadByte) {
+        return send(reliable, action.thing, id, action.action, payloadByte);
+    }
+    bool send(bool reliable, BeetonActionId action, uint8_t id,
+              const std::vector<uint8_t> &payload = {},
+              BeetonPriority priority = BEETON_PRIORITY_NORMAL) {
+        return send(reliable, action.thing, id, action.action, payload, priority);
+    }
+    BeetonSendResult trySend(bool reliable, BeetonActionId action, uint8_t id,
+                             const std::vector<uint8_t> &payload,
+                             BeetonPriority priority = BEETON_PRIORITY_NORMAL) {
+        return trySend(reliable, action.thing, id, action.action, payload, priority);
+    }
+    bool sendState(BeetonActionId action, uint8_t id, uint8_t payloadByte,
+                   BeetonPriority priority = BEETON_PRIORITY_NORMAL) {
+        return sendState(action.thing, id, action.action, payloadByte, priority);
+    }
+    bool sendState(BeetonActionId action, uint8_t id, const std::vector<uint8_t> &payload,
+                   BeetonPriority priority = BEETON_PRIORITY_NORMAL) {
+        return sendState(action.thing, id, action.action, payload, priority);
+    }
 
     // Message receive handler
+    // The payload view is only valid for the duration of the callback.
     using MessageCallback = std::function<void(uint16_t thing, uint8_t id, uint8_t action,
-                                      const std::vector<uint8_t> &payload)>;
+                                      const BeetonPayloadView &payload)>;
     void onMessage(MessageCallback cb){ messageCallback = std::move(cb);}
+
+    // Per thing/id/action handlers, looked up in one hash probe per packet.
+    // Traffic with no handler still goes to onMessage(). Registering again
+    // replaces the handler (from inside that handler, once it returns); an
+    // empty one removes it. The function pointer form skips std::function
+    // and hands back context on every call.
+    using ActionFunction = void (*)(void *context, uint16_t thing, uint8_t id, uint8_t action,
+                                    const BeetonPayloadView &payload);
+    void onAction(uint16_t thing, uint8_t id, uint8_t action, MessageCallback handler);
+    void onAction(uint16_t thing, uint8_t id, uint8_t action, ActionFunction fn,
+                  void *context = nullptr);
+    void onAction(BeetonActionId action, uint8_t id, MessageCallback handler) {
+        onAction(action.thing, id, action.action, std::move(handler));
+    }
+    void onAction(BeetonActionId action, uint8_t id, ActionFunction fn, void *context = nullptr) {
+        onAction(action.thing, id, action.action, fn, context);
+    }
                        
     // === Reliability Callbacks ===
     using AckSuccessCallback = std::function<void(uint16_t thing, uint8_t id, uint8_t action, uint16_t seq)>;
@@ -57,66 +364,313 @@ class Beeton {
 
     void onAckSuccess(AckSuccessCallback cb) { ackSuccessCb = std::move(cb); }
     void onAckFail(AckFailCallback cb)       { ackFailCb = std::move(cb); }
+
+    const BeetonStats &getStats() const { return stats; }
+
+    // How reliable packets we receive are acknowledged. Delayed ACKs need
+    // senders that understand BEETON_FLAG_SACK.
+    void setAckMode(BeetonAckMode mode, uint16_t delayMs = BEETON_ACK_DELAY_MS);
+
+    // Non-urgent frames sent per update() once the transmit queue backs up
+    // (0 = no limit). Until the budget is spent, frames go out immediately.
+    void setTxBudget(uint16_t framesPerUpdate) { txBudget = txCredits = framesPerUpdate; }
+
+    // Which node confirms our reliable sends. Applies to sends made after the call.
+    void setDeliveryMode(BeetonDeliveryMode mode) { deliveryMode = mode; }
+
+    // Milliseconds until the next retry, timeout, delayed ACK or batch flush
+    // is due: 0 if overdue or frames are queued, UINT32_MAX when nothing is
+    // in flight.
+    uint32_t nextDeadlineMs();
+
+    // Coalesce sends to the same next hop into BATCH frames. Queued records
+    // are flushed from update() once the oldest is delayMs old (0 = next tick).
+    void setBatching(bool enabled, uint16_t delayMs = 0);
+
+    // RTT/RTO state for a next hop (a joiner's only next hop is the leader).
+    bool getRttEstimate(const String &ip, BeetonRttEstimate &out);
+
+    // Named groups of thing/id pairs, from all_groups.csv or defined here.
+    // A joiner's groups are shared with the leader, which does the fan-out.
+    void defineGroup(const String &name, uint16_t group, const std::vector<BeetonThing> &members);
+    bool getGroupId(const String &name, uint16_t &outGroup);
+
+    // One frame to the leader, one per owning node from there. Members owned
+    // by the sender are skipped. From a joiner the ACK callbacks fire once
+    // for the group (thing = group, id = 0), in end-to-end mode once every
+    // owner has acknowledged. From the leader each member is its own record,
+    // so they fire per member (thing, id) as its owner acknowledges.
+    bool sendGroup(bool reliable, uint16_t group, uint8_t action);
+    bool sendGroup(bool reliable, uint16_t group, uint8_t action, const std::vector<uint8_t> &payload,
+                   BeetonPriority priority = BEETON_PRIORITY_NORMAL);
     
     
     
-    String getThingName(uint16_t thing);
-    String getActionName(const String &thingName, uint8_t actionId);
-    bool getThingId(const String &name, uint16_t &outThing);
-    bool getActionId(const String &thingName, const String &actionName, uint8_t &outAction);
+    // Things this node hosts, replacing define_this.csv
+    void defineThings(const std::vector<BeetonThing> &list);
+
+    // Name lookups from the SD card CSVs. Nodes that only use catalogue IDs
+    // can build with BEETON_NO_NAME_LOOKUP to drop these and the SD load,
+    // which leaves the symbol table empty; their things then come from
+    // defineThings(). Define it for every unit, library sources included.
+    // Names come back as stable pointers into the symbol table ("unknown"
+    // if not found); nothing is allocated per call.
+#ifndef BEETON_NO_NAME_LOOKUP
+    const char *getThingName(uint16_t thing);
+    const char *getActionName(uint16_t thing, uint8_t actionId);
+    const char *getActionName(const char *thingName, uint8_t actionId);
+    const char *getActionName(const String &thingName, uint8_t actionId) {
+        return getActionName(thingName.c_str(), actionId);
+    }
+    bool getThingId(const char *name, size_t len, uint16_t &outThing);
+    bool getThingId(const char *name, uint16_t &outThing) {
+        return getThingId(name, strlen(name), outThing);
+    }
+    bool getThingId(const String &name, uint16_t &outThing) {
+        return getThingId(name.c_str(), name.length(), outThing);
+    }
+    bool getActionId(const char *thingName, size_t thingLen, const char *actionName,
+                     size_t actionLen, uint8_t &outAction);
+    bool getActionId(const char *thingName, const char *actionName, uint8_t &outAction) {
+        return getActionId(thingName, strlen(thingName), actionName, strlen(actionName), outAction);
+    }
+    bool getActionId(const String &thingName, const String &actionName, uint8_t &outAction) {
+        return getActionId(thingName.c_str(), thingName.length(), actionName.c_str(),
+                           actionName.length(), outAction);
+    }
     bool thingExists(uint16_t thing);
+    bool actionExists(uint16_t thing, uint8_t actionId);
     bool actionExists(const String &thingName, uint8_t actionId);
 
+    // Re-reads the CSVs and applies only what changed to the live tables, so
+    // routes and registrations survive. Names handed out earlier stay valid.
+    // Groups are added or updated, never dropped. A joiner whose
+    // define_this.csv changed re-announces, unless defineThings() set its
+    // things. False if the things CSV can't be read.
+    bool reloadMappings(BeetonMappingChanges &changes);
+    bool reloadMappings() {
+        BeetonMappingChanges changes;
+        return reloadMappings(changes);
+    }
+#endif
+
     
 
   private:
     LightThread *lightThread = nullptr;
-    std::map<uint32_t, String> thingIdToIp; // thing<<8 | id → IP
+    // Known mesh nodes, interned once. The handle is the index into nodes and
+    // the text form is cached so sends never re-format the address.
+    struct Node {
+        BeetonAddress address;
+        String ipText;
+        bool compact = false; // announced it can parse compact headers
+    };
+    std::vector<Node> nodes;
+    std::unordered_map<BeetonAddress, uint16_t, BeetonAddressHash> nodeIndex;
+    BeetonFlatMap thingRoutes; // thing<<8 | id → owner node handle
     std::vector<BeetonThing> localThings;
-    std::map<String, uint16_t> nameToThing;
-    std::map<uint16_t, String> thingToName;
-    std::map<String, std::map<String, uint8_t>> actionNameToId;
-    std::map<String, std::map<uint8_t, String>> actionIdToName;
+    bool thingsDefinedInCode = false; // set by defineThings(); the CSV defines no longer apply
+    // Thing and action names from the CSVs. Kept, empty, under
+    // BEETON_NO_NAME_LOOKUP so the class layout is the same in every unit.
+    BeetonSymbolTable symbols;
+    std::map<String, uint16_t> nameToGroup;
+    std::map<uint16_t, std::vector<BeetonThing>> groupMembers;
     bool usbConnected = false;
 
-    void loadMappings(const char *thingsPath = "/beeton/all_things.csv",
-                      const char *actionsPath = "/beeton/all_actions.csv",
-                      const char *definePath = "/beeton/define_this.csv");
+    // SD loading; only defined without BEETON_NO_NAME_LOOKUP
+    typedef std::map<uint16_t, std::vector<BeetonThing>> GroupMap;
+
+    void loadMappings(const char *thingsPath = BEETON_THINGS_PATH,
+                      const char *actionsPath = BEETON_ACTIONS_PATH,
+                      const char *definePath = BEETON_DEFINE_PATH,
+                      const char *groupsPath = BEETON_GROUPS_PATH,
+                      const char *indexPath = BEETON_INDEX_PATH);
     void ensureFileExists(const char *path);
-    void loadThings(const char *path);
-    void loadActions(const char *path);
-    void loadDefines(const char *path);
+    void loadThings(const char *path, BeetonSymbolTable &table, BeetonMappingIndexBuilder &index);
+    void loadActions(const char *path, BeetonSymbolTable &table, BeetonMappingIndexBuilder &index);
+    void loadDefines(const char *path, const BeetonSymbolTable &table,
+                     std::vector<BeetonThing> &defines, BeetonMappingIndexBuilder &index);
+    void loadGroups(const char *path, const BeetonSymbolTable &table,
+                    std::map<String, uint16_t> &names, GroupMap &members);
+    void applySymbolChanges(const BeetonSymbolTable &next, BeetonMappingChanges &changes);
+    void logSkippedRows(const char *path, size_t count);
+    BeetonIndexStamp fileStamp(const char *path);
+    bool loadMappingIndex(const char *path, const BeetonIndexStamp (&stamps)[BEETON_INDEX_SOURCE_COUNT]);
+    void writeMappingIndex(const char *path, const BeetonIndexStamp (&stamps)[BEETON_INDEX_SOURCE_COUNT],
+                           BeetonMappingIndexBuilder &index);
 
     bool isSetup = false;
+
+    // --- Local addressing ---
+    // Version + origin bytes shared by every frame we build, refreshed only
+    // when our address can have changed (join callback, link coming up).
+    uint8_t headerPrefix[BEETON_HEADER_PREFIX_SIZE] = {0};
+    bool headerPrefixValid = false;
+    BeetonAddress leaderAddress;
+    bool linkWasReady = false;
+    std::vector<uint8_t> txFrame; // reused by buildPacket()
+    // Compact header origin the leader gave us; a leader's own is always 0
+    // and a joiner's short is node handle + 1 in the leader's table. Compact
+    // frames carry the epoch of the leader that assigned it.
+    uint16_t shortAddress = BEETON_SHORT_ADDRESS_NONE;
+    uint8_t shortEpoch = 0;  // joiner: from ASSIGN_SHORT
+    uint8_t leaderEpoch = 0; // leader: drawn at begin()
+    std::vector<uint8_t> relayBuffer; // reused by relayFrame()
+
+    void refreshLocalAddresses();
     
   
     // --- Reliability state ---
     struct Pending {
-        String destIp;
-        String originIp;
+        BeetonAddress dest;
         uint16_t thing;
         uint8_t id, action;
-        std::vector<uint8_t> payload;
+        BeetonFrame frame; // encoded once into a slab block, resent verbatim
         uint16_t seq;
+        uint32_t sentMs;    // first transmission, for RTT sampling
         uint32_t nextDueMs;
-        uint16_t timeoutMs;
+        uint16_t timeoutMs; // doubles on every retry
         uint8_t  retriesLeft;
+        bool state = false; // sent by sendState(), may be superseded
+        BeetonPriority priority = BEETON_PRIORITY_NORMAL; // retries keep their class
+    };
+
+    // IPsec-style anti-replay state for one origin: the highest seq seen
+    // plus a bitmap of the BEETON_REPLAY_WINDOW seqs behind it.
+    struct ReplayWindow {
+        uint16_t highest;
+        uint64_t bitmap;
+        uint32_t lastSeenMs;
+        bool ackPending; // delayed ACK mode: a SACK for this origin is queued
+        bool ackViaLeader; // end-to-end traffic: ACKs go back through the leader
+    };
+    enum SeqCheck : uint8_t {
+        SEQ_NEW,
+        SEQ_DUPLICATE, // seen inside the window: ACK again, don't deliver
+        SEQ_STALE      // behind the window: neither ACKed nor delivered
     };
 
-    struct SeqKey {
-        String origin;
+    // Min-heap of retry deadlines. Entries are not removed on ACK; a popped
+    // entry is stale when its seq is gone or was rescheduled since.
+    struct RetryDeadline {
+        uint32_t dueMs;
         uint16_t seq;
     };
-    
-    std::map<uint16_t, Pending> pending;
-    std::vector<std::pair<SeqKey, uint32_t>> seen;
+
+    BeetonPool<Pending, BEETON_PENDING_POOL_SIZE> pending;
+    BeetonFlatMap pendingBySeq; // seq -> slot in pending
+    BeetonFrameSlab<BEETON_FRAME_SMALL_SIZE, BEETON_FRAME_SMALL_COUNT, BEETON_FRAME_LARGE_SIZE,
+                    BEETON_FRAME_LARGE_COUNT>
+        frames; // pending and queued frame bytes
+    std::vector<uint8_t> sendScratch; // slab bytes copied out for sendUdp()
+    std::vector<uint8_t> byteScratch; // payload of the one-byte send()/sendState()
+    std::vector<RetryDeadline> retryHeap;
+    std::map<BeetonAddress, BeetonRttEstimate> rttByDest;
+    std::unordered_map<BeetonAddress, ReplayWindow, BeetonAddressHash> replayWindows;
+    uint32_t lastReplaySweepMs = 0;
+
+    // Origins owed a delayed ACK, in the order they fell due
+    struct AckDue {
+        BeetonAddress origin;
+        uint32_t dueMs;
+    };
+    BeetonAckMode ackMode = BEETON_ACK_IMMEDIATE;
+    uint16_t ackDelayMs = BEETON_ACK_DELAY_MS;
+    std::vector<AckDue> ackQueue;
+
+    // Leader only: who to hand an end-to-end ACK to, by (owner node, seq)
+    struct RelayEntry {
+        uint16_t destNode = BeetonFlatMap::NONE;
+        uint16_t originNode = BeetonFlatMap::NONE;
+        uint16_t seq = 0;
+        uint32_t expiresMs = 0;
+        bool aggregate = false; // group fan-out: relay once every owner has ACKed
+        bool acked = false;
+    };
+    std::unordered_map<uint32_t, uint16_t> stateSeqs; // thing/id/action → latest state seq
+    BeetonDeliveryMode deliveryMode = BEETON_DELIVERY_HOP_BY_HOP;
+    RelayEntry relayEntries[BEETON_RELAY_STATE_MAX];
+    size_t relayNext = 0;
+    BeetonStats stats;
     
     
+    // --- Flow control ---
+    struct HeldMessage {
+        bool state;
+        BeetonPriority priority;
+        uint16_t thing;
+        uint8_t id, action;
+        std::vector<uint8_t> payload;
+    };
+    struct Flow {
+        uint8_t inFlight = 0;
+        uint8_t credit = BEETON_CREDIT_UNADVERTISED; // last one the next hop advertised
+        std::deque<HeldMessage> held;
+    };
+    std::unordered_map<BeetonAddress, Flow, BeetonAddressHash> flows;
+    uint8_t flowWindow = BEETON_FLOW_WINDOW;
+    uint8_t flowHeldMax = BEETON_FLOW_HELD_MAX;
+    uint8_t advertisedCredit = BEETON_CREDIT_UNADVERTISED;
+
+    // --- Transmit queue ---
+    // Frames are copied into the slab because buildPacket() reuses its buffer
+    struct TxItem {
+        BeetonAddress dest;
+        BeetonFrame frame;
+        uint32_t queuedMs;
+    };
+    BeetonRing<TxItem, BEETON_TX_QUEUE_MAX> txQueues[BEETON_PRIORITY_COUNT]; // urgent is always empty
+    uint16_t txBudget = BEETON_TX_BUDGET_PER_UPDATE;
+    uint16_t txCredits = BEETON_TX_BUDGET_PER_UPDATE;
+
+    // --- Batching ---
+    struct Batch {
+        BeetonAddress dest;
+        bool reliable = false;
+        BeetonPriority priority = BEETON_PRIORITY_NORMAL;
+        uint32_t openedMs = 0;
+        uint16_t thing = 0; // first record, mirrored into the frame header
+        uint8_t id = 0, action = 0;
+        std::vector<uint8_t> records;
+    };
+
+    // Per-destination slices of a batch the leader has to split up
+    struct BatchSplit {
+        uint16_t node;
+        size_t recordCount;
+        std::vector<uint8_t> frame;
+    };
+
+    bool batchingEnabled = false;
+    uint16_t batchDelayMs = 0;
+    std::vector<Batch> batches;
+    std::vector<BatchSplit> batchSplits; // reused scratch, entries past batchSplitCount are idle
+    size_t batchSplitCount = 0;
+
     AckSuccessCallback ackSuccessCb;
     AckFailCallback    ackFailCb;
     MessageCallback    messageCallback;
+
+    // --- Action dispatch ---
+    struct ActionHandler {
+        ActionFunction fn = nullptr;
+        void *context = nullptr;
+        MessageCallback callback;
+        // A callback replaced while it runs is swapped in once it returns
+        uint8_t running = 0;
+        bool replaced = false;
+        MessageCallback replacement;
+    };
+    // A deque, so a handler may register others while it runs
+    BeetonFlatMap actionRoutes; // thing/id/action → index into actionHandlers
+    std::deque<ActionHandler> actionHandlers;
     
-    void defineThings(const std::vector<BeetonThing> &list);
+
+    // Replies go out as frames once a host has asked for them
+    bool usbBinary = false;
+    BeetonFrameReceiver<BEETON_USB_FRAME_MAX_BODY> usbReceiver;
+    BeetonFrameWriter<BEETON_USB_FRAME_MAX_BODY> usbWriter;
+    std::vector<uint8_t> usbPayload; // reused by framed SENDs
 
     void sendAllKnownThingsToUsb();
     void sendFileOverUsb(String filename);
@@ -124,44 +678,139 @@ class Beeton {
     void sendCommandFromUsb(String sendCommand);
     void updateUsb();
     void handleUsbLine(String input);
-    void sendRemoteSerialPacket(const BeetonPacket &packet);
+    void handleUsbFrame();
+    void sendUsbFrame();
+    void sendUsbHello();
+    void sendRemoteSerialPacket(const BeetonPacketView &packet);
+
+    // LightThread boundary: the only place addresses become text
+    bool sendFrame(const Node &dest, const std::vector<uint8_t> &frame);
+    bool sendFrame(const BeetonAddress &dest, const std::vector<uint8_t> &frame);
+    bool sendFrame(const BeetonAddress &dest, const BeetonFrame &frame);
 
-    std::vector<uint8_t> buildPacket(uint8_t flags, uint16_t seq, uint16_t thing, uint8_t id, uint8_t action,
-                                         const std::vector<uint8_t> &payload);
-    bool parsePacket(const std::vector<uint8_t> &raw, BeetonPacket &packet);
+    // Returned frame is reused, valid until the next buildPacket() call.
+    // The header is compact when dest has negotiated it, v1 otherwise.
+    const std::vector<uint8_t> &buildPacket(const BeetonAddress &dest, uint8_t flags, uint16_t seq,
+                                            uint16_t thing, uint8_t id, uint8_t action,
+                                            const uint8_t *payload, size_t payloadLen);
+    bool compactHeaderTo(const BeetonAddress &dest);
+    size_t headerSizeTo(const BeetonAddress &dest);
+    bool resolveCompactOrigin(BeetonPacketView &packet);
+    void encodeV1Header(const BeetonAddress &origin, uint8_t flags, uint16_t seq, uint16_t thing,
+                        uint8_t id, uint8_t action, std::vector<uint8_t> &out);
+    // Frame as the leader passes it on: raw for v1, re-encoded as v1 if compact
+    const std::vector<uint8_t> &relayFrame(const std::vector<uint8_t> &raw,
+                                           const BeetonPacketView &packet);
+    bool sendAnnounce();
+    void assignShortAddress(const BeetonPacketView &announce);
+    void refuseCompactOrigin(const String &srcIp, const BeetonPacketView &packet);
+    void dropCompactHeaderTo(const BeetonAddress &dest);
+    void refreshRetryHeader(Pending &p);
     // Internal message hook (used by UDP recv)
     void handlePacket(const std::vector<uint8_t> &raw,
-                               const BeetonPacket &packet);
-    bool handleAckPacket(const BeetonPacket &packet);
-    bool handleReliablePacket(const BeetonPacket &packet);
-    bool handleLeaderControlPacket(const BeetonPacket &packet);
-    bool forwardPacketIfLeader(const std::vector<uint8_t> &raw, const BeetonPacket &packet);
-    void dispatchLocalPacket(const BeetonPacket &packet);
+                               const BeetonPacketView &packet);
+    void handleBatchPacket(const std::vector<uint8_t> &raw, const BeetonPacketView &packet);
+    bool handleAckPacket(const BeetonPacketView &packet);
+    bool retirePending(uint16_t seq, bool sampleTiming);
+    void queueDelayedAck(const BeetonAddress &origin, bool viaLeader, uint32_t nowMs);
+    bool ackViaLeader(const BeetonPacketView &packet);
+    bool isRelayedByLeader(const BeetonPacketView &packet);
+    void recordRelay(uint16_t destNode, const BeetonPacketView &packet, bool aggregate = false);
+    bool hasOutstandingRelay(uint16_t originNode, uint16_t seq, uint32_t nowMs);
+    bool relayAckIfLeader(const std::vector<uint8_t> &raw, const BeetonPacketView &packet);
+    void flushDelayedAcks(bool force);
+    bool handleReliablePacket(const BeetonPacketView &packet);
+    bool handleLeaderControlPacket(const BeetonPacketView &packet);
+    bool fastForwardIfLeader(const std::vector<uint8_t> &raw);
+    bool forwardPacketIfLeader(const std::vector<uint8_t> &raw, const BeetonPacketView &packet);
+    void dispatchLocalPacket(const BeetonPacketView &packet);
+    void deliverLocal(uint16_t thing, uint8_t id, uint8_t action, const BeetonPayloadView &payload);
+    ActionHandler &actionHandlerFor(uint16_t thing, uint8_t id, uint8_t action);
+    void setActionCallback(ActionHandler &entry, MessageCallback callback);
+
+    bool resolveNextHop(uint16_t thing, uint8_t id, BeetonAddress &dest);
+    bool transmit(const BeetonAddress &dest, const std::vector<uint8_t> &frame, bool reliable,
+                  uint16_t seq, uint16_t thing, uint8_t id, uint8_t action,
+                  BeetonPriority priority = BEETON_PRIORITY_NORMAL);
+    bool transmitMessage(const BeetonAddress &dest, bool reliable, BeetonPriority priority, bool state,
+                         uint16_t thing, uint8_t id, uint8_t action, const uint8_t *payload,
+                         size_t payloadLen);
+    bool queueFrame(const BeetonAddress &dest, const std::vector<uint8_t> &frame,
+                    BeetonPriority priority);
+    bool queueFrame(const BeetonAddress &dest, const uint8_t *frame, size_t frameLen,
+                    BeetonPriority priority);
+    bool canTrackReliable(size_t frameLen);
+    Pending *findPending(uint16_t seq);
+    void untrackPending(Pending *p);
+    void releasePending(Pending *p);
+    bool txQueueFull(BeetonPriority priority);
+
+    bool windowOpen(const BeetonAddress &dest, uint8_t replacing = 0);
+    BeetonSendResult holdMessage(const BeetonAddress &dest, bool state, BeetonPriority priority,
+                                 uint16_t thing, uint8_t id, uint8_t action,
+                                 const std::vector<uint8_t> &payload);
+    void pendingRemoved(const BeetonAddress &dest, bool release);
+    void releaseHeld(const BeetonAddress &dest);
+    void releaseAllHeld();
+    bool mustHold(const BeetonAddress &dest, uint8_t replacing = 0);
+    void applyCredit(const BeetonAddress &dest, uint8_t credit);
+    bool hasTxBacklog(BeetonPriority priority);
+    void pumpTx();
+    static BeetonPriority priorityOf(uint8_t flags);
+    void reportDelivery(const Pending &p, bool delivered);
+
+    bool queueBatchRecord(const BeetonAddress &dest, bool reliable, BeetonPriority priority,
+                          uint16_t thing, uint8_t id, uint8_t action, const uint8_t *payload,
+                          size_t payloadLen);
+    bool flushBatch(Batch &batch);
+    void flushBatches(bool force);
+    bool flushBatchTo(const BeetonAddress &dest);
+    bool dropBatchRecord(const BeetonAddress &dest, uint16_t thing, uint8_t id, uint8_t action);
+    void appendBatchRecord(std::vector<uint8_t> &out, uint16_t thing, uint8_t id, uint8_t action,
+                           const uint8_t *payload, size_t payloadLen);
+
+    void sendGroupDefinition(uint16_t group, const std::vector<BeetonThing> &members);
+    void registerGroupMembers(const BeetonPayloadView &definition);
+    void handleGroupPacket(const BeetonPacketView &packet);
+    bool groupHasRemoteOwner(const BeetonPacketView &packet);
+    bool batchHasRemoteOwner(const BeetonPacketView &packet);
+    bool isLocalThing(uint16_t thing, uint8_t id);
 
     void logBeeton(BeetonLogLevel level, const char *fmt, ...);
     std::vector<String> splitCsv(const String &input);
-    String formatPayload(const std::vector<uint8_t> &payload);
+    String formatPayload(const BeetonPayloadView &payload);
     
     // --- IPv6 origin helpers ---
-    std::vector<uint8_t> parseIpv6(const String &ip);
-    String               formatIpv6(const std::vector<uint8_t> &bytes);
+    bool   parseIpv6(const String &ip, BeetonAddress &out);
+    void   formatIpv6(const BeetonAddress &addr, char *out, size_t outLen);
     
 
     uint32_t makeThingIdKey(uint16_t thing, uint8_t id);
+    uint32_t makeStateKey(uint16_t thing, uint8_t id, uint8_t action);
     uint16_t keyToThing(uint32_t key);
     uint8_t keyToId(uint32_t key);
-    void registerThingOwner(uint16_t thing, uint8_t id, const String &ip);
-    bool getThingOwnerIp(uint16_t thing, uint8_t id, String &outIp);
+    uint16_t internNode(const BeetonAddress &address);
+    void registerThingOwners(const BeetonPayloadView &announce, const BeetonAddress &owner);
+    // Pointer stays valid until the next node is interned
+    const Node *findThingOwner(uint16_t thing, uint8_t id);
     
     // --- Internal helpers ---
     uint16_t allocSeq();
-    bool isLeaderAddress(const BeetonPacket &packet);
+    bool isLeaderAddress(const BeetonPacketView &packet);
     bool isLeaderInternalAction(uint8_t action);
     void appendUint16(std::vector<uint8_t> &out, uint16_t value);
-    uint16_t readUint16(const std::vector<uint8_t> &data, size_t offset);
+    uint16_t readUint16(const uint8_t *data, size_t offset);
     // === Internal tick for reliability retries ===
     void pumpReliable();
-    bool wasSeenAndMark(const String& origin, uint16_t seq, uint32_t nowMs);
+    void scheduleRetry(uint16_t seq, uint32_t dueMs);
+    bool isStaleDeadline(const RetryDeadline &deadline);
+    static bool dueLater(const RetryDeadline &a, const RetryDeadline &b);
+    uint16_t retryTimeoutFor(const BeetonAddress &dest);
+    void sampleRtt(const BeetonAddress &dest, uint32_t rttMs);
+    uint32_t withJitter(uint32_t timeoutMs);
+    SeqCheck checkAndMarkSeq(const BeetonAddress &origin, uint16_t seq, uint32_t nowMs);
+    bool startsNewSequence(const BeetonPacketView &packet);
+    void expireReplayWindows(uint32_t nowMs);
 
 };
 
@@ -3,27 +3,155 @@
 #include <Arduino.h>
 
 // Packet layout
+static constexpr uint8_t BEETON_PROTOCOL_VERSION = 1;
 static constexpr size_t BEETON_ORIGIN_IP_SIZE = 16;
+static constexpr size_t BEETON_HEADER_PREFIX_SIZE = 1 + BEETON_ORIGIN_IP_SIZE; // version + origin
 static constexpr size_t BEETON_HEADER_SIZE = 24;
+static constexpr size_t BEETON_OFFSET_VERSION = 0;
+static constexpr size_t BEETON_OFFSET_ORIGIN = 1;
+static constexpr size_t BEETON_OFFSET_FLAGS = 17;
+static constexpr size_t BEETON_OFFSET_SEQ = 18;
+static constexpr size_t BEETON_OFFSET_THING = 20;
+static constexpr size_t BEETON_OFFSET_ID = 22;
+static constexpr size_t BEETON_OFFSET_ACTION = 23;
+
+// Compact (v2) header: a leader-assigned 2-byte short origin replaces the
+// 16-byte EID. Only used on links to and from the leader; frames the leader
+// relays onward are always re-encoded as v1. The epoch byte is the leader's
+// boot nonce from ASSIGN_SHORT, so a short address handed out before a leader
+// restart is refused rather than taken for whichever node now holds it.
+static constexpr uint8_t BEETON_PROTOCOL_VERSION_COMPACT = 2;
+static constexpr size_t BEETON_COMPACT_HEADER_SIZE = 11;
+static constexpr size_t BEETON_COMPACT_PREFIX_SIZE = 4; // version + short origin + epoch
+static constexpr size_t BEETON_COMPACT_OFFSET_ORIGIN = 1;
+static constexpr size_t BEETON_COMPACT_OFFSET_EPOCH = 3;
+static constexpr size_t BEETON_COMPACT_OFFSET_FLAGS = 4;
+static constexpr size_t BEETON_COMPACT_OFFSET_SEQ = 5;
+static constexpr size_t BEETON_COMPACT_OFFSET_THING = 7;
+static constexpr size_t BEETON_COMPACT_OFFSET_ID = 9;
+static constexpr size_t BEETON_COMPACT_OFFSET_ACTION = 10;
+static constexpr uint16_t BEETON_SHORT_ADDRESS_LEADER = 0;
+static constexpr uint16_t BEETON_SHORT_ADDRESS_NONE = 0xFFFF;
 
 // Leader/control address
 static constexpr uint16_t BEETON_LEADER_THING = 0xFFFF;
 static constexpr uint8_t  BEETON_LEADER_ID = 0xFF;
+constexpr uint8_t BEETON_LEADER_ACTION_DEFINE_GROUP = 0xFC; // joiner → leader: [group hi, group lo] + WHO_AM_I triples
+// leader → joiner: [short hi, short lo, epoch]; a NONE short means "not
+// known here", and the joiner drops back to v1 and announces again
+constexpr uint8_t BEETON_LEADER_ACTION_ASSIGN_SHORT = 0xFD;
 constexpr uint8_t BEETON_LEADER_ACTION_SERIAL = 0xFE;
 constexpr uint8_t BEETON_LEADER_ACTION_ANNOUNCE = 0xFF;
 
 // Packet flags
 static constexpr uint8_t BEETON_FLAG_ACK = 0x01;
 static constexpr uint8_t BEETON_FLAG_RELIABLE = 0x02;
+static constexpr uint8_t BEETON_FLAG_BATCH = 0x04;
+// Selective ACK: seq is the newest acknowledged, payload is a 64-bit
+// big-endian bitmap where bit i acknowledges seq - i.
+static constexpr uint8_t BEETON_FLAG_SACK = 0x08;
+static constexpr size_t BEETON_SACK_BITMAP_SIZE = 8;
+// End-to-end delivery: the leader relays without ACKing and the owner's ACK
+// travels back through the leader to the origin.
+static constexpr uint8_t BEETON_FLAG_E2E = 0x10;
+// Set by a joiner on its WHO_AM_I when it can speak the compact header
+static constexpr uint8_t BEETON_FLAG_COMPACT_CAPABLE = 0x20;
+// Group send: the header's thing is a group id and the leader fans the action
+// out to every member, one frame per owning node.
+static constexpr uint8_t BEETON_FLAG_GROUP = 0x40;
+// Urgent traffic: relays put it ahead of anything they have queued
+static constexpr uint8_t BEETON_FLAG_URGENT = 0x80;
+
+// Batched frames: the payload is a run of [thing:2][id][action][len][payload:len]
+// records for the same next hop. The header's thing/id/action repeat the first record.
+static constexpr size_t BEETON_BATCH_RECORD_HEADER_SIZE = 5;
+static constexpr size_t BEETON_BATCH_MAX_RECORD_PAYLOAD = 255;
+// Keep a batch inside one 802.15.4 frame after 6LoWPAN compression
+static constexpr size_t BEETON_BATCH_MAX_FRAME_SIZE = 96;
 // Reliable delivery
-static constexpr unsigned long BEETON_RETRY_INTERVAL_MS = 250;
+static constexpr unsigned long BEETON_RETRY_INTERVAL_MS = 250; // initial RTO before any RTT sample
 static constexpr uint8_t BEETON_MAX_RETRIES = 5;
+static constexpr uint32_t BEETON_RTO_MIN_MS = 40;
+static constexpr uint32_t BEETON_RTO_MAX_MS = 4000;
+// A compact frame retried this often is resent as v1: the peer may have lost
+// the short address it was sent under
+static constexpr uint8_t BEETON_COMPACT_FALLBACK_RETRIES = 2;
+// Stale deadlines the retry heap may carry beyond two per pending entry
+// before scheduleRetry() compacts it
+static constexpr size_t BEETON_RETRY_HEAP_SLACK = 16;
 static constexpr unsigned long BEETON_SEEN_PACKET_TTL_MS = 10000;
-static constexpr size_t BEETON_SEEN_PACKET_MAX = 32;
+static constexpr size_t BEETON_SEEN_ORIGIN_MAX = 64;  // anti-replay windows kept at once
+static constexpr uint16_t BEETON_REPLAY_WINDOW = 64;  // seqs tracked behind the highest seen
+static constexpr uint16_t BEETON_ACK_DELAY_MS = 20;   // default hold time for delayed ACKs
+static constexpr size_t BEETON_RELAY_STATE_MAX = 64;  // leader: end-to-end frames awaiting an ACK
+static constexpr uint32_t BEETON_RELAY_STATE_TTL_MS = 10000;
+// Transmit queue: non-urgent frames sent per update() once traffic backs up
+static constexpr uint16_t BEETON_TX_BUDGET_PER_UPDATE = 8;
+static constexpr size_t BEETON_TX_QUEUE_MAX = 32; // per class; further frames are dropped
+// Fixed pools for the reliability engine, sized at compile time. Reliable
+// frames bigger than a large block are refused.
+//
+// BEETON_PENDING_POOL_SIZE caps reliable messages in flight across all next
+// hops; past it send() returns BEETON_SEND_NO_MEMORY. The default lets a
+// leader keep a full flow window open to a few dozen nodes (hundreds of
+// messages) for about 12 KB of entries plus their frame blocks. Small blocks
+// also hold frames waiting in the transmit queues.
+//
+// Nodes that never lead can build with BEETON_JOINER_ONLY for pools sized to
+// a few flow windows toward the leader, or define any of these directly. Like
+// BEETON_NO_NAME_LOOKUP, the same values must reach every unit.
+#ifndef BEETON_PENDING_POOL_SIZE
+#ifdef BEETON_JOINER_ONLY
+#define BEETON_PENDING_POOL_SIZE 32
+#else
+#define BEETON_PENDING_POOL_SIZE 256
+#endif
+#endif
+#ifndef BEETON_FRAME_SMALL_COUNT
+#define BEETON_FRAME_SMALL_COUNT (BEETON_PENDING_POOL_SIZE + 2 * BEETON_TX_QUEUE_MAX)
+#endif
+#ifndef BEETON_FRAME_LARGE_COUNT
+#ifdef BEETON_JOINER_ONLY
+#define BEETON_FRAME_LARGE_COUNT 4
+#else
+#define BEETON_FRAME_LARGE_COUNT 16
+#endif
+#endif
+static constexpr size_t BEETON_FRAME_SMALL_SIZE = 64;
+static constexpr size_t BEETON_FRAME_LARGE_SIZE = 256;
+// Flow control, per next hop: reliable messages in flight, and how many more
+// may wait for the window before trySend() reports the queue full
+static constexpr uint8_t BEETON_FLOW_WINDOW = 8;
+static constexpr uint8_t BEETON_FLOW_HELD_MAX = 16;
+// ACKs may end with one byte of receiver credit: how many more reliable
+// messages the ACKing node will take. This value means "not advertised".
+static constexpr uint8_t BEETON_CREDIT_UNADVERTISED = 0xFF;
+
+// Mapping CSVs on SD, and the longest row the loaders accept
+static constexpr const char *BEETON_THINGS_PATH = "/beeton/all_things.csv";
+static constexpr const char *BEETON_ACTIONS_PATH = "/beeton/all_actions.csv";
+static constexpr const char *BEETON_DEFINE_PATH = "/beeton/define_this.csv";
+static constexpr const char *BEETON_GROUPS_PATH = "/beeton/all_groups.csv";
+static constexpr const char *BEETON_INDEX_PATH = "/beeton/mappings.idx";
+static constexpr size_t BEETON_CSV_LINE_MAX = 128;
 
 // USB
 static constexpr uint32_t BEETON_USB_BAUD = 115200;
 
+// Framed binary USB messages (BeetonFraming.h), all integers big-endian.
+// A host sends HELLO (or the console line BINARY) to switch the leader's
+// replies to frames, and ASCII to switch back. Types are shared by a
+// request and its reply.
+static constexpr uint8_t BEETON_USB_FRAME_VERSION = 1;
+static constexpr size_t BEETON_USB_FRAME_MAX_BODY = 256;
+constexpr uint8_t BEETON_USB_FRAME_HELLO = 0x01;     // [version] → [version, max body hi, lo]
+constexpr uint8_t BEETON_USB_FRAME_ASCII = 0x02;     // back to console text
+constexpr uint8_t BEETON_USB_FRAME_SEND = 0x03;      // [reliable, thing hi, lo, id, action] + payload
+constexpr uint8_t BEETON_USB_FRAME_THINGS = 0x04;    // → [last] + (thing hi, lo, id) triples
+constexpr uint8_t BEETON_USB_FRAME_FILE = 0x05;      // [name] → [last] + file bytes
+constexpr uint8_t BEETON_USB_FRAME_REMOTE = 0x06;    // → [origin x16] + payload
+constexpr uint8_t BEETON_USB_FRAME_TEXT = 0x7F;      // a console line, either way
+
 // UDP / protocol
 static constexpr uint16_t BEETON_DEFAULT_UDP_PORT = 12345;
 
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-pass CSV tokenizer for the mapping files. The source is pulled in
+// fixed blocks through reader.read(uint8_t *, size_t) (an SD File, or any
+// host stand-in), and each row is split in place inside a fixed line buffer,
+// so loading allocates nothing. Blank lines and lines starting with '#' are
+// skipped, whitespace around fields is dropped, and rows can be lower-cased
+// as the loaders expect. Rows longer than LineMax are skipped and counted.
+
+static constexpr size_t BEETON_CSV_MAX_FIELDS = 4;
+
+// NUL-terminated field of the current row, valid until the next call to next()
+struct BeetonCsvField {
+    const char *data = nullptr;
+    size_t len = 0;
+
+    // Plain decimal, no sign; false on anything else or overflow
+    bool toUint(uint32_t &out) const {
+        if(len == 0) {
+            return false;
+        }
+        uint32_t value = 0;
+        for(size_t i = 0; i < len; i++) {
+            char c = data[i];
+            if(c < '0' || c > '9' || value > (UINT32_MAX - uint32_t(c - '0')) / 10) {
+                return false;
+            }
+            value = value * 10 + uint32_t(c - '0');
+        }
+        out = value;
+        return true;
+    }
+};
+
+template <typename Reader, size_t BlockSize = 256, size_t LineMax = 128> class BeetonCsvReader {
+  public:
+    explicit BeetonCsvReader(Reader &source, bool lowerCase = true)
+        : reader(source), fold(lowerCase) {}
+
+    // Advances to the next data row; false at end of input
+    bool next() {
+        while(readLine()) {
+            if(split()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t fieldCount() const { return count; }
+    const BeetonCsvField &field(size_t i) const { return fields[i]; }
+    size_t lineNumber() const { return lineNo; }
+    size_t skippedLines() const { return skipped; }
+
+  private:
+    Reader &reader;
+    bool fold;
+    uint8_t block[BlockSize];
+    size_t blockLen = 0;
+    size_t blockPos = 0;
+    bool eof = false;
+
+    char line[LineMax + 1];
+    size_t lineLen = 0;
+    size_t lineNo = 0;
+    size_t skipped = 0;
+
+    BeetonCsvField fields[BEETON_CSV_MAX_FIELDS];
+    size_t count = 0;
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    // Copies the next line into line[], refilling the block as needed
+    bool readLine() {
+        lineLen = 0;
+        bool overflow = false;
+        bool any = false;
+
+        while(true) {
+            if(blockPos == blockLen) {
+                if(eof) {
+                    break;
+                }
+                size_t got = reader.read(block, BlockSize);
+                if(got == 0 || got > BlockSize) {
+                    eof = true;
+                    break;
+                }
+                blockLen = got;
+                blockPos = 0;
+            }
+
+            char c = char(block[blockPos++]);
+            any = true;
+            if(c == '\n') {
+                break;
+            }
+            if(lineLen < LineMax) {
+                line[lineLen++] = fold && c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+            } else {
+                overflow = true;
+            }
+        }
+
+        if(!any) {
+            return false;
+        }
+        lineNo++;
+        if(overflow) {
+            skipped++;
+            lineLen = 0;
+        }
+        line[lineLen] = '\0';
+        return true;
+    }
+
+    // Splits line[] on commas; false for rows with nothing to load
+    bool split() {
+        size_t start = 0;
+        size_t end = lineLen;
+        while(start < end && isSpace(line[start])) {
+            start++;
+        }
+        while(end > start && isSpace(line[end - 1])) {
+            end--;
+        }
+        if(start == end || line[start] == '#') {
+            return false;
+        }
+
+        count = 0;
+        size_t fieldStart = start;
+        for(size_t i = start; i <= end; i++) {
+            if(i < end && line[i] != ',') {
+                continue;
+            }
+            size_t a = fieldStart;
+            size_t b = i;
+            while(a < b && isSpace(line[a])) {
+                a++;
+            }
+            while(b > a && isSpace(line[b - 1])) {
+                b--;
+            }
+            // Only bytes already scanned are overwritten
+            line[b] = '\0';
+            if(count < BEETON_CSV_MAX_FIELDS) {
+                fields[count++] = {line + a, b - a};
+            }
+            fieldStart = i + 1;
+        }
+        return true;
+    }
+};
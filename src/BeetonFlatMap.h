@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Open-addressing hash table from 32-bit keys to 16-bit values (linear
+// probing, power-of-two capacity). Slots are contiguous, so a lookup is a
+// hash plus a short forward scan. NONE is reserved as the empty marker and
+// cannot be stored as a value.
+class BeetonFlatMap {
+  public:
+    static constexpr uint16_t NONE = 0xFFFF;
+
+    uint16_t find(uint32_t key) const {
+        if(slots.empty()) {
+            return NONE;
+        }
+
+        for(size_t i = indexFor(key);; i = (i + 1) & mask()) {
+            const Slot &slot = slots[i];
+            if(slot.value == NONE) {
+                return NONE;
+            }
+            if(slot.key == key) {
+                return slot.value;
+            }
+        }
+    }
+
+    // Inserts or overwrites the value for key
+    void insert(uint32_t key, uint16_t value) {
+        if((count + 1) * 10 > slots.size() * 7) {
+            rehash(slots.empty() ? 16 : slots.size() * 2);
+        }
+
+        for(size_t i = indexFor(key);; i = (i + 1) & mask()) {
+            Slot &slot = slots[i];
+            if(slot.value == NONE) {
+                slot.key = key;
+                slot.value = value;
+                count++;
+                return;
+            }
+            if(slot.key == key) {
+                slot.value = value;
+                return;
+            }
+        }
+    }
+
+    // Backward-shift delete: later entries of the probe run move up into the
+    // hole, so the table never holds tombstones
+    void erase(uint32_t key) {
+        if(slots.empty()) {
+            return;
+        }
+
+        size_t hole = indexFor(key);
+        for(;; hole = (hole + 1) & mask()) {
+            if(slots[hole].value == NONE) {
+                return;
+            }
+            if(slots[hole].key == key) {
+                break;
+            }
+        }
+        count--;
+
+        for(size_t i = (hole + 1) & mask(); slots[i].value != NONE; i = (i + 1) & mask()) {
+            // An entry may fill the hole unless its home lies between the two
+            size_t home = indexFor(slots[i].key);
+            if(((i - home) & mask()) >= ((i - hole) & mask())) {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole] = Slot();
+    }
+
+    // Grow ahead of a bulk insert so it rehashes at most once
+    void reserve(size_t entries) {
+        size_t capacity = slots.empty() ? 16 : slots.size();
+        while(entries * 10 > capacity * 7) {
+            capacity *= 2;
+        }
+        if(capacity != slots.size()) {
+            rehash(capacity);
+        }
+    }
+
+    size_t size() const { return count; }
+
+    template <typename Fn> void forEach(Fn fn) const {
+        for(const Slot &slot : slots) {
+            if(slot.value != NONE) {
+                fn(slot.key, slot.value);
+            }
+        }
+    }
+
+  private:
+    struct Slot {
+        uint32_t key = 0;
+        uint16_t value = NONE;
+    };
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+
+    size_t mask() const { return slots.size() - 1; }
+
+    // murmur3 finaliser: thing/id keys are dense, so spread them out
+    size_t indexFor(uint32_t key) const {
+        key ^= key >> 16;
+        key *= 0x85EBCA6B;
+        key ^= key >> 13;
+        key *= 0xC2B2AE35;
+        key ^= key >> 16;
+        return key & mask();
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old;
+        old.swap(slots);
+        slots.resize(capacity);
+        count = 0;
+        for(const Slot &slot : old) {
+            if(slot.value != NONE) {
+                insert(slot.key, slot.value);
+            }
+        }
+    }
+};
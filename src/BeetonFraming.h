@@ -0,0 +1,183 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary framing for the leader's USB link. A message is
+//
+//   type | body | CRC-16/CCITT-FALSE over type and body (big-endian)
+//
+// COBS-encoded so it holds no zero byte, and sent as 0x00 <encoded> 0x00.
+// Console text never contains 0x00, so framed messages and ASCII lines can
+// share the port: a receiver drops whatever sits between two delimiters
+// without a valid CRC, and bytes outside a frame are left to the console.
+
+static inline uint16_t beetonCrc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF) {
+    for(size_t i = 0; i < len; i++) {
+        crc ^= uint16_t(data[i]) << 8;
+        for(int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? uint16_t((crc << 1) ^ 0x1021) : uint16_t(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static constexpr size_t beetonCobsMaxEncoded(size_t len) { return len + len / 254 + 1; }
+
+// out must hold beetonCobsMaxEncoded(len) bytes; returns the encoded length
+static inline size_t beetonCobsEncode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code = 0; // where the current run's length byte goes
+    size_t o = 1;
+    uint8_t run = 1;
+    for(size_t i = 0; i < len; i++) {
+        if(in[i] != 0) {
+            out[o++] = in[i];
+            run++;
+        }
+        if(in[i] == 0 || run == 0xFF) {
+            out[code] = run;
+            code = o++;
+            run = 1;
+        }
+    }
+    out[code] = run;
+    return o;
+}
+
+// Decodes in place-safe (out may equal in); returns 0 on malformed input
+static inline size_t beetonCobsDecode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t o = 0;
+    size_t i = 0;
+    while(i < len) {
+        uint8_t run = in[i++];
+        if(run == 0 || i + run - 1 > len) {
+            return 0;
+        }
+        for(uint8_t k = 1; k < run; k++) {
+            out[o++] = in[i++];
+        }
+        if(run != 0xFF && i < len) {
+            out[o++] = 0;
+        }
+    }
+    return o;
+}
+
+// Builds one wire frame in a fixed buffer: begin(), append() the body, finish()
+template <size_t MaxBody> class BeetonFrameWriter {
+  public:
+    static constexpr size_t MAX_BODY = MaxBody;
+
+    void begin(uint8_t type) {
+        raw[0] = type;
+        rawLen = 1;
+        overflow = false;
+    }
+
+    void append(const uint8_t *data, size_t len) {
+        if(rawLen + len > 1 + MaxBody) {
+            overflow = true;
+            return;
+        }
+        for(size_t i = 0; i < len; i++) {
+            raw[rawLen++] = data[i];
+        }
+    }
+
+    void append(uint8_t byte) { append(&byte, 1); }
+
+    void appendUint16(uint16_t value) {
+        uint8_t bytes[2] = {uint8_t(value >> 8), uint8_t(value)};
+        append(bytes, 2);
+    }
+
+    // Overwrites a body byte already appended, e.g. a "last" flag
+    void set(size_t bodyOffset, uint8_t value) {
+        if(1 + bodyOffset < rawLen) {
+            raw[1 + bodyOffset] = value;
+        }
+    }
+
+    size_t room() const { return 1 + MaxBody - rawLen; }
+
+    // Wire bytes, delimiters included; nullptr if the body overflowed
+    const uint8_t *finish(size_t &len) {
+        if(overflow) {
+            len = 0;
+            return nullptr;
+        }
+        uint16_t crc = beetonCrc16(raw, rawLen);
+        raw[rawLen] = uint8_t(crc >> 8);
+        raw[rawLen + 1] = uint8_t(crc);
+
+        wire[0] = 0;
+        len = beetonCobsEncode(raw, rawLen + 2, wire + 1) + 1;
+        wire[len++] = 0;
+        return wire;
+    }
+
+  private:
+    uint8_t raw[1 + MaxBody + 2];
+    uint8_t wire[beetonCobsMaxEncoded(1 + MaxBody + 2) + 2];
+    size_t rawLen = 0;
+    bool overflow = false;
+};
+
+// Byte-at-a-time receiver. A 0x00 opens a frame and the next 0x00 closes it.
+template <size_t MaxBody> class BeetonFrameReceiver {
+  public:
+    // True if the byte belonged to framing, so the console should not see it.
+    // After a true return, ready() says whether a valid frame just completed.
+    bool push(uint8_t byte) {
+        complete = false;
+        if(byte == 0) {
+            if(!open || len == 0) {
+                // Back-to-back delimiters: the second opens the next frame
+                open = true;
+                len = 0;
+                dropped = false;
+                return true;
+            }
+            open = false;
+            close();
+            return true;
+        }
+        if(!open) {
+            return false;
+        }
+        if(len == sizeof(buffer)) {
+            dropped = true;
+        } else {
+            buffer[len++] = byte;
+        }
+        return true;
+    }
+
+    bool ready() const { return complete; }
+    bool inFrame() const { return open; }
+    uint8_t type() const { return buffer[0]; }
+    const uint8_t *body() const { return buffer + 1; }
+    size_t bodyLen() const { return decodedLen - 3; }
+    uint32_t errors() const { return badFrames; }
+
+  private:
+    uint8_t buffer[beetonCobsMaxEncoded(1 + MaxBody + 2)];
+    size_t len = 0;
+    size_t decodedLen = 0;
+    bool open = false;
+    bool dropped = false;
+    bool complete = false;
+    uint32_t badFrames = 0;
+
+    void close() {
+        decodedLen = dropped ? 0 : beetonCobsDecode(buffer, len, buffer);
+        len = 0;
+        if(decodedLen < 3 || decodedLen > 1 + MaxBody + 2 ||
+           beetonCrc16(buffer, decodedLen - 2) !=
+               uint16_t((buffer[decodedLen - 2] << 8) | buffer[decodedLen - 1])) {
+            badFrames++;
+            return;
+        }
+        complete = true;
+    }
+};
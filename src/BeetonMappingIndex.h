@@ -0,0 +1,258 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Binary form of all_things.csv, all_actions.csv and define_this.csv, kept
+// beside them on SD so boot skips the line-by-line parse:
+//
+//   header | things (by thing) | actions (by thing, action) | defines | string pool
+//
+// Records are fixed width in the little-endian layout of the ESP32 and most
+// hosts, so the file is read into one buffer and used in place.
+// Each source CSV's size and mtime are stamped in; any change means rebuild.
+
+static constexpr uint32_t BEETON_INDEX_MAGIC = 0x584E5442; // "BTNX"
+static constexpr uint16_t BEETON_INDEX_VERSION = 1;
+
+enum BeetonIndexSource {
+    BEETON_INDEX_THINGS,
+    BEETON_INDEX_ACTIONS,
+    BEETON_INDEX_DEFINES,
+    BEETON_INDEX_SOURCE_COUNT
+};
+
+struct BeetonIndexStamp {
+    uint32_t size = 0;
+    uint32_t mtime = 0;
+
+    bool operator==(const BeetonIndexStamp &other) const {
+        return size == other.size && mtime == other.mtime;
+    }
+};
+
+struct BeetonIndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    BeetonIndexStamp sources[BEETON_INDEX_SOURCE_COUNT];
+    uint32_t thingCount;
+    uint32_t actionCount;
+    uint32_t defineCount;
+    uint32_t poolSize;
+};
+
+// Names are NUL-terminated in the pool; offsets are from the pool start
+struct BeetonIndexThing {
+    uint16_t thing;
+    uint16_t nameLen;
+    uint32_t nameOffset;
+};
+
+struct BeetonIndexAction {
+    uint16_t thing;
+    uint8_t action;
+    uint8_t nameLen;
+    uint32_t nameOffset;
+};
+
+struct BeetonIndexDefine {
+    uint16_t thing;
+    uint8_t id;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(BeetonIndexHeader) == 48, "index header layout");
+static_assert(sizeof(BeetonIndexThing) == 8, "index thing layout");
+static_assert(sizeof(BeetonIndexAction) == 8, "index action layout");
+static_assert(sizeof(BeetonIndexDefine) == 4, "index define layout");
+
+// Read-only view over an index image. The buffer must outlive the view.
+class BeetonMappingIndexView {
+  public:
+    bool parse(const uint8_t *data, size_t size) {
+        if(!data || size < sizeof(BeetonIndexHeader) ||
+           uintptr_t(data) % alignof(BeetonIndexHeader) != 0) {
+            return false;
+        }
+
+        const BeetonIndexHeader *h = reinterpret_cast<const BeetonIndexHeader *>(data);
+        if(h->magic != BEETON_INDEX_MAGIC || h->version != BEETON_INDEX_VERSION) {
+            return false;
+        }
+
+        uint64_t need = sizeof(BeetonIndexHeader) + uint64_t(h->thingCount) * sizeof(BeetonIndexThing) +
+                        uint64_t(h->actionCount) * sizeof(BeetonIndexAction) +
+                        uint64_t(h->defineCount) * sizeof(BeetonIndexDefine) + h->poolSize;
+        if(need != size) {
+            return false;
+        }
+
+        const uint8_t *p = data + sizeof(BeetonIndexHeader);
+        const BeetonIndexThing *t = reinterpret_cast<const BeetonIndexThing *>(p);
+        p += h->thingCount * sizeof(BeetonIndexThing);
+        const BeetonIndexAction *a = reinterpret_cast<const BeetonIndexAction *>(p);
+        p += h->actionCount * sizeof(BeetonIndexAction);
+        const BeetonIndexDefine *d = reinterpret_cast<const BeetonIndexDefine *>(p);
+        p += h->defineCount * sizeof(BeetonIndexDefine);
+        const char *pool = reinterpret_cast<const char *>(p);
+
+        // Every name must sit inside the pool and end in its NUL
+        for(uint32_t i = 0; i < h->thingCount; i++) {
+            if(!validName(pool, h->poolSize, t[i].nameOffset, t[i].nameLen)) {
+                return false;
+            }
+        }
+        for(uint32_t i = 0; i < h->actionCount; i++) {
+            if(!validName(pool, h->poolSize, a[i].nameOffset, a[i].nameLen)) {
+                return false;
+            }
+        }
+
+        header = h;
+        thingRecords = t;
+        actionRecords = a;
+        defineRecords = d;
+        stringPool = pool;
+        return true;
+    }
+
+    size_t thingCount() const { return header->thingCount; }
+    size_t actionCount() const { return header->actionCount; }
+    size_t defineCount() const { return header->defineCount; }
+    const BeetonIndexThing &thingAt(size_t i) const { return thingRecords[i]; }
+    const BeetonIndexAction &actionAt(size_t i) const { return actionRecords[i]; }
+    const BeetonIndexDefine &defineAt(size_t i) const { return defineRecords[i]; }
+    const char *name(uint32_t offset) const { return stringPool + offset; }
+
+    // Binary searches over the sorted records; nullptr when absent
+    const char *thingName(uint16_t thing) const {
+        const BeetonIndexThing *end = thingRecords + header->thingCount;
+        const BeetonIndexThing *it = std::lower_bound(
+            thingRecords, end, thing,
+            [](const BeetonIndexThing &r, uint16_t key) { return r.thing < key; });
+        return it != end && it->thing == thing ? name(it->nameOffset) : nullptr;
+    }
+
+    const char *actionName(uint16_t thing, uint8_t action) const {
+        uint32_t key = (uint32_t(thing) << 8) | action;
+        const BeetonIndexAction *end = actionRecords + header->actionCount;
+        const BeetonIndexAction *it = std::lower_bound(
+            actionRecords, end, key, [](const BeetonIndexAction &r, uint32_t k) {
+                return ((uint32_t(r.thing) << 8) | r.action) < k;
+            });
+        return it != end && it->thing == thing && it->action == action ? name(it->nameOffset)
+                                                                       : nullptr;
+    }
+
+  private:
+    const BeetonIndexHeader *header = nullptr;
+    const BeetonIndexThing *thingRecords = nullptr;
+    const BeetonIndexAction *actionRecords = nullptr;
+    const BeetonIndexDefine *defineRecords = nullptr;
+    const char *stringPool = nullptr;
+
+    static bool validName(const char *pool, uint32_t poolSize, uint32_t offset, uint32_t len) {
+        return uint64_t(offset) + len < poolSize && pool[offset + len] == '\0';
+    }
+};
+
+// Collects the parsed CSVs and lays out an index image
+class BeetonMappingIndexBuilder {
+  public:
+    void addThing(uint16_t thing, const char *name, size_t len) {
+        unrepresentable |= len > UINT16_MAX;
+        things.push_back({thing, uint16_t(len), addName(name, len)});
+    }
+
+    void addAction(uint16_t thing, uint8_t action, const char *name, size_t len) {
+        unrepresentable |= len > UINT8_MAX;
+        actions.push_back({thing, action, uint8_t(len), addName(name, len)});
+    }
+
+    void addDefine(uint16_t thing, uint8_t id) { defines.push_back({thing, id, 0}); }
+
+    // False if a name is too long for its record; the CSVs are then the only source
+    bool build(const BeetonIndexStamp (&stamps)[BEETON_INDEX_SOURCE_COUNT],
+               std::vector<uint8_t> &out) {
+        if(unrepresentable) {
+            return false;
+        }
+
+        // Later rows win, as they do when the CSVs are loaded
+        std::stable_sort(things.begin(), things.end(),
+                         [](const BeetonIndexThing &a, const BeetonIndexThing &b) {
+                             return a.thing < b.thing;
+                         });
+        things.erase(dedupeLast(things.begin(), things.end(),
+                                [](const BeetonIndexThing &a, const BeetonIndexThing &b) {
+                                    return a.thing == b.thing;
+                                }),
+                     things.end());
+        std::stable_sort(actions.begin(), actions.end(),
+                         [](const BeetonIndexAction &a, const BeetonIndexAction &b) {
+                             return a.thing != b.thing ? a.thing < b.thing : a.action < b.action;
+                         });
+        actions.erase(dedupeLast(actions.begin(), actions.end(),
+                                 [](const BeetonIndexAction &a, const BeetonIndexAction &b) {
+                                     return a.thing == b.thing && a.action == b.action;
+                                 }),
+                      actions.end());
+
+        BeetonIndexHeader h = {};
+        h.magic = BEETON_INDEX_MAGIC;
+        h.version = BEETON_INDEX_VERSION;
+        for(int i = 0; i < BEETON_INDEX_SOURCE_COUNT; i++) {
+            h.sources[i] = stamps[i];
+        }
+        h.thingCount = uint32_t(things.size());
+        h.actionCount = uint32_t(actions.size());
+        h.defineCount = uint32_t(defines.size());
+        h.poolSize = uint32_t(pool.size());
+
+        out.clear();
+        out.reserve(sizeof(h) + things.size() * sizeof(BeetonIndexThing) +
+                    actions.size() * sizeof(BeetonIndexAction) +
+                    defines.size() * sizeof(BeetonIndexDefine) + pool.size());
+        append(out, &h, sizeof(h));
+        append(out, things.data(), things.size() * sizeof(BeetonIndexThing));
+        append(out, actions.data(), actions.size() * sizeof(BeetonIndexAction));
+        append(out, defines.data(), defines.size() * sizeof(BeetonIndexDefine));
+        append(out, pool.data(), pool.size());
+        return true;
+    }
+
+  private:
+    std::vector<BeetonIndexThing> things;
+    std::vector<BeetonIndexAction> actions;
+    std::vector<BeetonIndexDefine> defines;
+    std::vector<char> pool;
+    bool unrepresentable = false;
+
+    uint32_t addName(const char *name, size_t len) {
+        uint32_t offset = uint32_t(pool.size());
+        pool.insert(pool.end(), name, name + len);
+        pool.push_back('\0');
+        return offset;
+    }
+
+    // Like std::unique, but keeps the last of each run of equal records
+    template <typename It, typename Eq> static It dedupeLast(It first, It last, Eq eq) {
+        It out = first;
+        for(It it = first; it != last; ++it) {
+            if(it + 1 != last && eq(*it, *(it + 1))) {
+                continue;
+            }
+            *out++ = *it;
+        }
+        return out;
+    }
+
+    static void append(std::vector<uint8_t> &out, const void *data, size_t size) {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+};
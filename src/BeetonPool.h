@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Fixed-capacity storage carved out when the owner is constructed, so the
+// steady-state send/ACK path never touches the heap. Running out is reported
+// by a nullptr / false return, never by growing.
+
+// Object pool: acquire() hands out a default-constructed slot.
+template <typename T, size_t N> class BeetonPool {
+    static_assert(N < 0xFFFF, "slots are indexed by uint16_t");
+
+  public:
+    static constexpr uint16_t NO_SLOT = 0xFFFF;
+
+    BeetonPool() {
+        for(size_t i = 0; i < N; i++) {
+            freeSlots[i] = uint16_t(N - 1 - i);
+        }
+    }
+
+    T *acquire() {
+        if(freeCount == 0) {
+            return nullptr;
+        }
+        uint16_t slot = freeSlots[--freeCount];
+        used[slot] = true;
+        slots[slot] = T();
+        return &slots[slot];
+    }
+
+    // Ignores pointers that are not one of this pool's slots
+    void release(T *item) {
+        uint16_t slot = slotOf(item);
+        if(slot == NO_SLOT || !used[slot]) {
+            return;
+        }
+        used[slot] = false;
+        freeSlots[freeCount++] = slot;
+    }
+
+    // Stable index of a slot, for side tables keyed into the pool
+    uint16_t slotOf(const T *item) const {
+        uintptr_t offset = uintptr_t(item) - uintptr_t(slots);
+        size_t slot = offset / sizeof(T);
+        if(uintptr_t(item) < uintptr_t(slots) || slot >= N || offset % sizeof(T) != 0) {
+            return NO_SLOT;
+        }
+        return uint16_t(slot);
+    }
+
+    // nullptr unless the slot is handed out
+    T *at(uint16_t slot) { return slot < N && used[slot] ? &slots[slot] : nullptr; }
+
+    template <typename Fn> void forEach(Fn fn) {
+        for(size_t i = 0; i < N; i++) {
+            if(used[i]) {
+                fn(slots[i]);
+            }
+        }
+    }
+
+    size_t size() const { return N - freeCount; }
+    bool empty() const { return freeCount == N; }
+    bool full() const { return freeCount == 0; }
+    static constexpr size_t capacity() { return N; }
+
+  private:
+    T slots[N];
+    bool used[N] = {};
+    uint16_t freeSlots[N];
+    size_t freeCount = N;
+};
+
+// FIFO ring of at most N items
+template <typename T, size_t N> class BeetonRing {
+  public:
+    bool push(const T &item) {
+        if(count == N) {
+            return false;
+        }
+        items[(head + count) % N] = item;
+        count++;
+        return true;
+    }
+
+    T &front() { return items[head]; }
+
+    void pop() {
+        head = (head + 1) % N;
+        count--;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+
+  private:
+    T items[N];
+    size_t head = 0;
+    size_t count = 0;
+};
+
+// Frame bytes held in a slab block
+struct BeetonFrame {
+    uint8_t *data = nullptr;
+    uint16_t size = 0;
+
+    bool valid() const { return data != nullptr; }
+};
+
+// Two-class slab for frame bytes: most frames fit a small block, announces
+// and batches take a large one. Frames bigger than a large block are refused.
+template <size_t SmallSize, size_t SmallCount, size_t LargeSize, size_t LargeCount>
+class BeetonFrameSlab {
+  public:
+    static constexpr size_t maxFrameSize() { return LargeSize; }
+
+    bool canHold(size_t size) const {
+        return (size <= SmallSize && small.size() < SmallCount) ||
+               (size <= LargeSize && large.size() < LargeCount);
+    }
+
+    BeetonFrame acquire(const uint8_t *bytes, size_t size) {
+        BeetonFrame frame;
+        Block<SmallSize> *s = size <= SmallSize ? small.acquire() : nullptr;
+        if(s) {
+            frame.data = s->bytes;
+        } else if(size <= LargeSize) {
+            Block<LargeSize> *l = large.acquire();
+            frame.data = l ? l->bytes : nullptr;
+        }
+
+        if(frame.data) {
+            memcpy(frame.data, bytes, size);
+            frame.size = uint16_t(size);
+        }
+        return frame;
+    }
+
+    void release(BeetonFrame &frame) {
+        if(!frame.data) {
+            return;
+        }
+        // Blocks start with their bytes, so the pointer is the block; only
+        // the pool that owns it will accept it
+        small.release(reinterpret_cast<Block<SmallSize> *>(frame.data));
+        large.release(reinterpret_cast<Block<LargeSize> *>(frame.data));
+        frame = BeetonFrame();
+    }
+
+    size_t blocksInUse() const { return small.size() + large.size(); }
+
+  private:
+    template <size_t Size> struct Block {
+        uint8_t bytes[Size];
+    };
+
+    BeetonPool<Block<SmallSize>, SmallCount> small;
+    BeetonPool<Block<LargeSize>, LargeCount> large;
+};
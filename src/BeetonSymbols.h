@@ -0,0 +1,287 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <vector>
+
+#include "BeetonFlatMap.h"
+
+// Interned thing/action names. A name is copied once per scope (the things,
+// or one thing's actions) into chunked storage that never moves, so the
+// const char* handed out stay valid until clear(). Name → ID goes through one
+// open-addressing index keyed by (scope, bytes), whose slot also holds the
+// stored copy; ID → name is a thing lookup plus a direct index by action.
+class BeetonSymbolTable {
+  public:
+    // Storage that lives until clear(), for names already laid out with
+    // their NUL (an index file's string pool) and passed to bind*()
+    char *allocate(size_t size) {
+        chunks.emplace_back(new char[size]);
+        chunkUsed = CHUNK_SIZE;
+        return chunks.back().get();
+    }
+
+    // Copies name in, unless its scope already holds it
+    void addThing(const char *name, size_t len, uint16_t thing) {
+        bindThing(stored(SCOPE_THING, name, len), len, thing);
+    }
+
+    void addAction(uint16_t thing, const char *name, size_t len, uint8_t action) {
+        bindAction(thing, stored(thing, name, len), len, action);
+    }
+
+    // symbol must stay valid as long as the table, and is not interned.
+    // Rebinding an ID drops its old name.
+    void bindThing(const char *symbol, size_t len, uint16_t thing) {
+        ThingNames &entry = thingEntry(thing);
+        if(entry.name && strcmp(entry.name, symbol) != 0) {
+            eraseSlot(SCOPE_THING, entry.name, thing);
+        }
+        insertSlot(SCOPE_THING, symbol, len, thing);
+        entry.name = symbol;
+    }
+
+    void bindAction(uint16_t thing, const char *symbol, size_t len, uint8_t action) {
+        std::vector<const char *> &actions = thingEntry(thing).actions;
+        if(actions.size() <= action) {
+            actions.resize(size_t(action) + 1, nullptr);
+        }
+        if(actions[action] && strcmp(actions[action], symbol) != 0) {
+            eraseSlot(thing, actions[action], action);
+        }
+        insertSlot(thing, symbol, len, action);
+        actions[action] = symbol;
+    }
+
+    bool thingId(const char *name, size_t len, uint16_t &out) const {
+        const NameSlot *slot = findSlot(SCOPE_THING, name, len);
+        if(!slot) {
+            return false;
+        }
+        out = slot->value;
+        return true;
+    }
+
+    bool actionId(uint16_t thing, const char *name, size_t len, uint8_t &out) const {
+        const NameSlot *slot = findSlot(thing, name, len);
+        if(!slot) {
+            return false;
+        }
+        out = uint8_t(slot->value);
+        return true;
+    }
+
+    // nullptr when unknown
+    const char *thingName(uint16_t thing) const {
+        uint16_t index = thingIndex.find(thing);
+        return index == BeetonFlatMap::NONE ? nullptr : things[index].name;
+    }
+
+    const char *actionName(uint16_t thing, uint8_t action) const {
+        uint16_t index = thingIndex.find(thing);
+        if(index == BeetonFlatMap::NONE || action >= things[index].actions.size()) {
+            return nullptr;
+        }
+        return things[index].actions[action];
+    }
+
+    // Forgets a thing's name and all its actions. The name bytes stay in
+    // storage, so pointers handed out earlier remain valid until clear().
+    void removeThing(uint16_t thing) {
+        uint16_t index = thingIndex.find(thing);
+        if(index == BeetonFlatMap::NONE || !things[index].name) {
+            return;
+        }
+
+        ThingNames &entry = things[index];
+        for(size_t action = 0; action < entry.actions.size(); action++) {
+            if(entry.actions[action]) {
+                eraseSlot(thing, entry.actions[action], uint16_t(action));
+            }
+        }
+        eraseSlot(SCOPE_THING, entry.name, thing);
+        entry.name = nullptr;
+        entry.actions.clear();
+    }
+
+    void removeAction(uint16_t thing, uint8_t action) {
+        uint16_t index = thingIndex.find(thing);
+        if(index == BeetonFlatMap::NONE || action >= things[index].actions.size() ||
+           !things[index].actions[action]) {
+            return;
+        }
+        eraseSlot(thing, things[index].actions[action], action);
+        things[index].actions[action] = nullptr;
+    }
+
+    // fn(uint16_t thing, const char *name) for every named thing
+    template <typename Fn> void forEachThing(Fn fn) const {
+        for(const ThingNames &entry : things) {
+            if(entry.name) {
+                fn(entry.thing, entry.name);
+            }
+        }
+    }
+
+    // fn(uint8_t action, const char *name) for every action of thing
+    template <typename Fn> void forEachAction(uint16_t thing, Fn fn) const {
+        uint16_t index = thingIndex.find(thing);
+        if(index == BeetonFlatMap::NONE) {
+            return;
+        }
+        const std::vector<const char *> &actions = things[index].actions;
+        for(size_t action = 0; action < actions.size(); action++) {
+            if(actions[action]) {
+                fn(uint8_t(action), actions[action]);
+            }
+        }
+    }
+
+    void clear() {
+        chunks.clear();
+        chunkUsed = CHUNK_SIZE;
+        slots.clear();
+        slotCount = 0;
+        things.clear();
+        thingIndex = BeetonFlatMap();
+    }
+
+  private:
+    // Actions are scoped by their thing ID, which never exceeds 0xFFFF
+    static constexpr uint32_t SCOPE_THING = 0x10000;
+    static constexpr size_t CHUNK_SIZE = 512;
+
+    struct NameSlot {
+        const char *name = nullptr; // nullptr marks an empty slot
+        uint32_t scope = 0;
+        uint16_t len = 0;
+        uint16_t value = 0;
+    };
+
+    struct ThingNames {
+        uint16_t thing = 0;
+        const char *name = nullptr; // nullptr once removed
+        std::vector<const char *> actions; // indexed by action ID
+    };
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunkUsed = CHUNK_SIZE;
+    std::vector<NameSlot> slots;
+    size_t slotCount = 0;
+    std::vector<ThingNames> things;
+    BeetonFlatMap thingIndex; // thing ID → index into things
+
+    ThingNames &thingEntry(uint16_t thing) {
+        uint16_t index = thingIndex.find(thing);
+        if(index == BeetonFlatMap::NONE) {
+            index = uint16_t(things.size());
+            things.emplace_back();
+            things.back().thing = thing;
+            thingIndex.insert(thing, index);
+        }
+        return things[index];
+    }
+
+    // The copy an index slot of this scope already holds, else a new one
+    const char *stored(uint32_t scope, const char *name, size_t len) {
+        const NameSlot *slot = findSlot(scope, name, len);
+        return slot ? slot->name : store(name, len);
+    }
+
+    // Names share a chunk until it fills; one longer than a chunk gets its own
+    const char *store(const char *name, size_t len) {
+        size_t need = len + 1;
+        if(chunkUsed + need > CHUNK_SIZE) {
+            chunks.emplace_back(new char[need > CHUNK_SIZE ? need : CHUNK_SIZE]);
+            chunkUsed = 0;
+        }
+
+        char *copy = chunks.back().get() + chunkUsed;
+        memcpy(copy, name, len);
+        copy[len] = '\0';
+        chunkUsed = need > CHUNK_SIZE ? CHUNK_SIZE : chunkUsed + need;
+        return copy;
+    }
+
+    // FNV-1a over the scope and the name bytes
+    static uint32_t hash(uint32_t scope, const char *name, size_t len) {
+        uint32_t h = 2166136261u;
+        for(int i = 0; i < 3; i++) {
+            h = (h ^ ((scope >> (8 * i)) & 0xFF)) * 16777619u;
+        }
+        for(size_t i = 0; i < len; i++) {
+            h = (h ^ uint8_t(name[i])) * 16777619u;
+        }
+        return h;
+    }
+
+    const NameSlot *findSlot(uint32_t scope, const char *name, size_t len) const {
+        if(slots.empty()) {
+            return nullptr;
+        }
+
+        size_t mask = slots.size() - 1;
+        for(size_t i = hash(scope, name, len) & mask;; i = (i + 1) & mask) {
+            const NameSlot &slot = slots[i];
+            if(!slot.name) {
+                return nullptr;
+            }
+            if(slot.scope == scope && slot.len == len && memcmp(slot.name, name, len) == 0) {
+                return &slot;
+            }
+        }
+    }
+
+    // Removes the slot for name if it still maps to value. Later slots of the
+    // probe run are shifted back, so lookups never need tombstones.
+    void eraseSlot(uint32_t scope, const char *name, uint16_t value) {
+        const NameSlot *found = findSlot(scope, name, strlen(name));
+        if(!found || found->value != value) {
+            return;
+        }
+
+        size_t mask = slots.size() - 1;
+        size_t hole = size_t(found - slots.data());
+        slots[hole] = NameSlot();
+        slotCount--;
+        for(size_t i = (hole + 1) & mask; slots[i].name; i = (i + 1) & mask) {
+            size_t home = hash(slots[i].scope, slots[i].name, slots[i].len) & mask;
+            if(((i - home) & mask) >= ((i - hole) & mask)) {
+                slots[hole] = slots[i];
+                slots[i] = NameSlot();
+                hole = i;
+            }
+        }
+    }
+
+    // Inserts or overwrites; name must outlive the table
+    void insertSlot(uint32_t scope, const char *name, size_t len, uint16_t value) {
+        if((slotCount + 1) * 10 > slots.size() * 7) {
+            std::vector<NameSlot> old;
+            old.swap(slots);
+            slots.resize(old.empty() ? 32 : old.size() * 2);
+            slotCount = 0;
+            for(const NameSlot &slot : old) {
+                if(slot.name) {
+                    insertSlot(slot.scope, slot.name, slot.len, slot.value);
+                }
+            }
+        }
+
+        size_t mask = slots.size() - 1;
+        for(size_t i = hash(scope, name, len) & mask;; i = (i + 1) & mask) {
+            NameSlot &slot = slots[i];
+            if(!slot.name) {
+                slot = {name, scope, uint16_t(len), value};
+                slotCount++;
+                return;
+            }
+            if(slot.scope == scope && slot.len == len && memcmp(slot.name, name, len) == 0) {
+                slot.value = value;
+                return;
+            }
+        }
+    }
+};
@@ -0,0 +1,43 @@
+#include "Beeton.h"
+// Optional heap instrumentation: build with BEETON_COUNT_ALLOCATIONS to count
+// every global operator new, e.g. to check the send/ACK path stays heap-free
+
+#ifdef BEETON_COUNT_ALLOCATIONS
+#include <new>
+#include <stdlib.h>
+
+static volatile uint32_t allocationCount = 0;
+
+uint32_t beetonAllocationCount() {
+    return allocationCount;
+}
+
+void *operator new(size_t size) {
+    allocationCount++;
+    void *p = malloc(size ? size : 1);
+    if(!p) {
+        abort();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+#endif
@@ -0,0 +1,247 @@
+#include "Beeton.h"
+// Coalescing of sends into BATCH frames, and splitting them on the leader
+
+void Beeton::setBatching(bool enabled, uint16_t delayMs) {
+    if(!enabled) {
+        flushBatches(true);
+    }
+    batchingEnabled = enabled;
+    batchDelayMs = delayMs;
+}
+
+void Beeton::appendBatchRecord(std::vector<uint8_t> &out, uint16_t thing, uint8_t id,
+                               uint8_t action, const uint8_t *payload, size_t payloadLen) {
+    appendUint16(out, thing);
+    out.push_back(id);
+    out.push_back(action);
+    out.push_back(uint8_t(payloadLen));
+    out.insert(out.end(), payload, payload + payloadLen);
+}
+
+bool Beeton::queueBatchRecord(const BeetonAddress &dest, bool reliable, BeetonPriority priority,
+                              uint16_t thing, uint8_t id, uint8_t action, const uint8_t *payload,
+                              size_t payloadLen) {
+    size_t recordSize = BEETON_BATCH_RECORD_HEADER_SIZE + payloadLen;
+    size_t headerSize = headerSizeTo(dest);
+
+    if(payloadLen > BEETON_BATCH_MAX_RECORD_PAYLOAD ||
+       headerSize + recordSize > BEETON_BATCH_MAX_FRAME_SIZE) {
+        return false;
+    }
+
+    Batch *batch = nullptr;
+    Batch *idle = nullptr;
+    for(auto &b : batches) {
+        if(b.dest == dest) {
+            batch = &b;
+            break;
+        }
+        if(!idle && b.records.empty()) {
+            idle = &b;
+        }
+    }
+
+    if(!batch) {
+        if(!idle) {
+            batches.emplace_back();
+            idle = &batches.back();
+        }
+        batch = idle;
+        batch->dest = dest;
+    }
+
+    // One reliability and priority class per frame; switching class or
+    // running out of room closes the open batch first, which also keeps send order.
+    if(!batch->records.empty() &&
+       (batch->reliable != reliable || batch->priority != priority ||
+        headerSize + batch->records.size() + recordSize > BEETON_BATCH_MAX_FRAME_SIZE)) {
+        flushBatch(*batch);
+    }
+
+    if(batch->records.empty()) {
+        batch->reliable = reliable;
+        batch->priority = priority;
+        batch->openedMs = millis();
+        batch->thing = thing;
+        batch->id = id;
+        batch->action = action;
+    }
+
+    appendBatchRecord(batch->records, thing, id, action, payload, payloadLen);
+    return true;
+}
+
+// False if the frame could not be sent or tracked; its records are dropped either way
+bool Beeton::flushBatch(Batch &batch) {
+    if(batch.records.empty()) {
+        return true;
+    }
+
+    uint16_t seq = batch.reliable ? allocSeq() : 0;
+    uint8_t flags = batch.reliable ? BEETON_FLAG_RELIABLE : 0;
+    if(batch.reliable && deliveryMode == BEETON_DELIVERY_END_TO_END) {
+        flags |= BEETON_FLAG_E2E;
+    }
+    if(batch.priority == BEETON_PRIORITY_URGENT) {
+        flags |= BEETON_FLAG_URGENT;
+    }
+    size_t firstLen = batch.records[BEETON_BATCH_RECORD_HEADER_SIZE - 1];
+
+    // A lone record goes out as a plain frame
+    const std::vector<uint8_t> &frame =
+        batch.records.size() == BEETON_BATCH_RECORD_HEADER_SIZE + firstLen
+            ? buildPacket(batch.dest, flags, seq, batch.thing, batch.id, batch.action,
+                          batch.records.data() + BEETON_BATCH_RECORD_HEADER_SIZE, firstLen)
+            : buildPacket(batch.dest, flags | BEETON_FLAG_BATCH, seq, batch.thing, batch.id, batch.action,
+                          batch.records.data(), batch.records.size());
+
+    bool ok = transmit(batch.dest, frame, batch.reliable, seq, batch.thing, batch.id, batch.action,
+                       batch.priority);
+    batch.records.clear();
+    return ok;
+}
+
+void Beeton::flushBatches(bool force) {
+    uint32_t now = millis();
+
+    for(auto &batch : batches) {
+        if(!batch.records.empty() && (force || now - batch.openedMs >= batchDelayMs)) {
+            flushBatch(batch);
+        }
+    }
+}
+
+bool Beeton::flushBatchTo(const BeetonAddress &dest) {
+    for(auto &batch : batches) {
+        if(batch.dest == dest) {
+            return flushBatch(batch);
+        }
+    }
+    return true;
+}
+
+// Removes a queued record for the same thing/id/action, if any
+bool Beeton::dropBatchRecord(const BeetonAddress &dest, uint16_t thing, uint8_t id, uint8_t action) {
+    for(auto &batch : batches) {
+        if(batch.dest != dest) {
+            continue;
+        }
+
+        std::vector<uint8_t> &records = batch.records;
+        for(size_t offset = 0; offset + BEETON_BATCH_RECORD_HEADER_SIZE <= records.size();) {
+            const uint8_t *r = records.data() + offset;
+            size_t size = BEETON_BATCH_RECORD_HEADER_SIZE + r[4];
+
+            if(readUint16(r, 0) == thing && r[2] == id && r[3] == action) {
+                records.erase(records.begin() + offset, records.begin() + offset + size);
+
+                // The frame header repeats the first record
+                if(offset == 0 && !records.empty()) {
+                    batch.thing = readUint16(records.data(), 0);
+                    batch.id = records[2];
+                    batch.action = records[3];
+                }
+                return true;
+            }
+            offset += size;
+        }
+        return false;
+    }
+    return false;
+}
+
+// True if any record is owned by a node other than the sender
+bool Beeton::batchHasRemoteOwner(const BeetonPacketView &packet) {
+    BeetonPacketView record;
+    size_t offset = 0;
+
+    while(packet.nextRecord(offset, record)) {
+        if(isLeaderAddress(record)) {
+            continue;
+        }
+        const Node *owner = findThingOwner(record.thing(), record.id());
+        if(owner && memcmp(owner->address.bytes, packet.originBytes(), BEETON_ORIGIN_IP_SIZE) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Records are handled one at a time. On the leader, records owned by other
+// nodes are regrouped per owner and relayed with the original origin, flags
+// and seq, so owners still dedupe and ACK against the sender.
+void Beeton::handleBatchPacket(const std::vector<uint8_t> &raw, const BeetonPacketView &packet) {
+    bool leader = isReady() && lightThread->getRole() == Role::LEADER;
+    size_t recordCount = 0;
+    batchSplitCount = 0;
+
+    // End-to-end batches skip handleReliablePacket(), so the leader dedupes
+    // its own records here; the owners dedupe theirs
+    bool endToEnd = leader &&
+                    (packet.flags() & (BEETON_FLAG_RELIABLE | BEETON_FLAG_E2E)) ==
+                        (BEETON_FLAG_RELIABLE | BEETON_FLAG_E2E) &&
+                    isRelayedByLeader(packet);
+    bool duplicate = endToEnd && checkAndMarkSeq(packet.origin(), packet.seq(), millis()) != SEQ_NEW;
+
+    BeetonPacketView record;
+    size_t offset = 0;
+
+    while(packet.nextRecord(offset, record)) {
+        recordCount++;
+
+        if(handleLeaderControlPacket(record)) {
+            continue;
+        }
+
+        if(leader && !isLeaderAddress(record)) {
+            uint16_t node = thingRoutes.find(makeThingIdKey(record.thing(), record.id()));
+
+            if(node != BeetonFlatMap::NONE &&
+               memcmp(nodes[node].address.bytes, packet.originBytes(), BEETON_ORIGIN_IP_SIZE) != 0) {
+                BatchSplit *split = nullptr;
+                for(size_t i = 0; i < batchSplitCount; i++) {
+                    if(batchSplits[i].node == node) {
+                        split = &batchSplits[i];
+                        break;
+                    }
+                }
+
+                if(!split) {
+                    if(batchSplitCount == batchSplits.size()) {
+                        batchSplits.emplace_back();
+                    }
+                    split = &batchSplits[batchSplitCount++];
+                    split->node = node;
+                    split->recordCount = 0;
+                    // Sender's header as v1, addressed to this record
+                    encodeV1Header(record.origin(), record.flags(), record.seq(), record.thing(),
+                                   record.id(), record.action(), split->frame);
+                }
+
+                const uint8_t *encoded = record.payload().data() - BEETON_BATCH_RECORD_HEADER_SIZE;
+                split->frame.insert(split->frame.end(), encoded,
+                                    encoded + BEETON_BATCH_RECORD_HEADER_SIZE + record.payload().size());
+                split->recordCount++;
+                continue;
+            }
+        }
+
+        if(!duplicate) {
+            dispatchLocalPacket(record);
+        }
+    }
+
+    for(size_t i = 0; i < batchSplitCount; i++) {
+        const BatchSplit &split = batchSplits[i];
+
+        // Each owner ACKs its share; the origin hears once all of them have
+        if(endToEnd) {
+            recordRelay(split.node, packet, true);
+        }
+
+        // Everything went one way: relay the original bytes untouched
+        queueFrame(nodes[split.node].address,
+                   split.recordCount == recordCount ? relayFrame(raw, packet) : split.frame,
+                   priorityOf(packet.flags()));
+    }
+}
@@ -1,56 +1,84 @@
 #include "Beeton.h"
+#include <esp_random.h>
 // Initialize Beeton and register callbacks with LightThread
 void Beeton::begin(LightThread &lt) {
     lightThread = &lt;
 
+#ifndef BEETON_NO_NAME_LOOKUP
     // Load name→ID mappings from SD card
     loadMappings();
+#endif
 
     if(lightThread && lightThread->getRole() == Role::LEADER) {
         Serial.begin(BEETON_USB_BAUD);
         usbConnected = true;
         logBeeton(BEETON_LOG_INFO, "Serial Started for Leader");
+#ifdef BEETON_JOINER_ONLY
+        logBeeton(BEETON_LOG_WARN, "Built with BEETON_JOINER_ONLY: pools are sized for a joiner");
+#endif
     }
 
+    // Short addresses handed out before a restart must not resolve
+    leaderEpoch = uint8_t(esp_random());
+
+    // Every pending entry holds at most two live deadlines, plus the slack
+    // scheduleRetry() allows before compacting and the push that follows it
+    retryHeap.reserve(2 * BEETON_PENDING_POOL_SIZE + BEETON_RETRY_HEAP_SLACK + 1);
+    pendingBySeq.reserve(BEETON_PENDING_POOL_SIZE);
+    sendScratch.reserve(BEETON_FRAME_LARGE_SIZE);
+    byteScratch.reserve(1);
+    // Sized for a v1 header too, so re-encoding a compact retry never grows them
+    txFrame.reserve(BEETON_FRAME_LARGE_SIZE);
+    relayBuffer.reserve(BEETON_FRAME_LARGE_SIZE);
+
     // Register callback for all incoming UDP messages
     lightThread->registerUdpReceiveCallback(
         [this](const String &srcIp, const std::vector<uint8_t> &raw) {
-            if(raw.size() < BEETON_HEADER_SIZE) {
+            if(raw.size() < BEETON_COMPACT_HEADER_SIZE) {
                 logBeeton(BEETON_LOG_DEBUG, "Ignored short packet from %s (len=%d)", srcIp.c_str(),
                           raw.size());
                 return;
             }
 
-            BeetonPacket packet;
+            // Leader relays most traffic straight from the fixed header offsets
+            if(fastForwardIfLeader(raw)) {
+                return;
+            }
+
+            BeetonPacketView packet;
 
-            // Parse the message and route it internally
-            if(parsePacket(raw, packet)) {
+            // Decode the header in place and route it internally
+            if(!packet.parse(raw.data(), raw.size())) {
+                logBeeton(BEETON_LOG_WARN, "Invalid packet from %s", srcIp.c_str());
+            } else if(packet.compact() && !resolveCompactOrigin(packet)) {
+                refuseCompactOrigin(srcIp, packet);
+            } else {
+                char origin[BEETON_IPV6_TEXT_BUFFER_SIZE];
+                formatIpv6(packet.origin(), origin, sizeof(origin));
                 logBeeton(BEETON_LOG_INFO,
                       "Parsed: ver=%u flags=%02x seq=%u thing=%04x id=%02x action=%02x payloadLen=%u origin=%s",
-                      packet.version, packet.flags, packet.seq, packet.thing, packet.id, packet.action, packet.payload.size(), packet.originIp.c_str());
+                      packet.version(), packet.flags(), packet.seq(), packet.thing(), packet.id(), packet.action(), packet.payload().size(), origin);
 
                 handlePacket(raw, packet);
-            } else {
-                logBeeton(BEETON_LOG_WARN, "Invalid packet from %s", srcIp.c_str());
             }
         });
 
     // Register callback for join events (only runs on joiner)
     lightThread->registerJoinCallback([this](const String &ip, const String &hashmac) {
+        // Joining can hand us a new address, so re-encode the header prefix
+        refreshLocalAddresses();
+
         // Only announce if we’re the joiner
         if(lightThread->getRole() != Role::JOINER)
             return;
 
-        // Package all local things into a WHO_AM_I announcement
-        std::vector<uint8_t> payload;
-        for(const auto &entry : localThings) {
-            logBeeton(BEETON_LOG_INFO, "Joiner adding thing id: %04X:%d", entry.thing, entry.id);
-            appendUint16(payload, entry.thing);
-            payload.push_back(entry.id);
-        }
-
-        this->send(true, BEETON_LEADER_THING,BEETON_LEADER_ID,BEETON_LEADER_ACTION_ANNOUNCE,payload);
+        sendAnnounce();
         logBeeton(BEETON_LOG_INFO, "Joiner Sent WHO_AM_I automatically");
+
+        // The leader may be new, so share our groups again
+        for(const auto &group : groupMembers) {
+            sendGroupDefinition(group.first, group.second);
+        }
     });
     isSetup = true;
 }
@@ -60,6 +88,22 @@ void Beeton::update() {
     if(lightThread)
         lightThread->update();
 
+    // Backlog from earlier ticks goes ahead of anything produced below
+    txCredits = txBudget;
+    pumpTx();
+
+    if(lightThread) {
+        bool ready = lightThread->isReady();
+        if(ready && !linkWasReady) {
+            refreshLocalAddresses();
+        }
+        linkWasReady = ready;
+    }
+
+    flushBatches(false);
+    flushDelayedAcks(false);
+    releaseAllHeld();
+
     if(lightThread && lightThread->getRole() == Role::LEADER) {
         updateUsb();
     }
@@ -87,146 +131,526 @@ bool Beeton::send(bool reliable, uint16_t thing, uint8_t id, uint8_t action) {
 
 // Overload for sending a message with a single byte payload
 bool Beeton::send(bool reliable, uint16_t thing, uint8_t id, uint8_t action, uint8_t payloadByte) {
-    std::vector<uint8_t> payload = {payloadByte};
-    return send(reliable, thing, id, action, payload);
+    byteScratch.assign(1, payloadByte);
+    return send(reliable, thing, id, action, byteScratch);
 }
 
 // Send message to a known (thing, id) destination, if its IP is known
 bool Beeton::send(bool reliable, uint16_t thing, uint8_t id, uint8_t action,
-                  const std::vector<uint8_t> &payload) {
-    uint8_t flags = 0;
-    uint16_t seq = 0;
+                  const std::vector<uint8_t> &payload, BeetonPriority priority) {
+    BeetonSendResult result = trySend(reliable, thing, id, action, payload, priority);
+    return result == BEETON_SEND_OK || result == BEETON_SEND_DEFERRED;
+}
 
+BeetonSendResult Beeton::trySend(bool reliable, uint16_t thing, uint8_t id, uint8_t action,
+                                 const std::vector<uint8_t> &payload, BeetonPriority priority) {
     if(!isReady()){
-        return false;
+        return BEETON_SEND_NOT_READY;
     }
 
+    BeetonAddress dest;
+    if(!resolveNextHop(thing, id, dest)) {
+        return BEETON_SEND_NO_ROUTE;
+    }
+
+    if(txQueueFull(priority)) {
+        return BEETON_SEND_QUEUE_FULL;
+    }
+
+    // Checked up front so a batched record is never accepted without room to track it
+    if(reliable && !canTrackReliable(headerSizeTo(dest) + payload.size())) {
+        if(pending.full()) {
+            stats.pendingPoolExhausted++;
+        } else {
+            stats.framePoolExhausted++;
+        }
+        return BEETON_SEND_NO_MEMORY;
+    }
+
+    // Past the window reliable messages wait their turn; urgent ones never do
+    if(reliable && priority != BEETON_PRIORITY_URGENT && mustHold(dest)) {
+        return holdMessage(dest, false, priority, thing, id, action, payload);
+    }
+
+    // Urgent frames never wait for a batch to fill
+    if(batchingEnabled && priority != BEETON_PRIORITY_URGENT) {
+        if(queueBatchRecord(dest, reliable, priority, thing, id, action, payload.data(),
+                            payload.size())) {
+            return BEETON_SEND_OK;
+        }
+        // Too big to batch: flush what is queued first so ordering holds
+        flushBatchTo(dest);
+    }
+
+    return transmitMessage(dest, reliable, priority, false, thing, id, action, payload.data(),
+                           payload.size())
+               ? BEETON_SEND_OK
+               : BEETON_SEND_FAILED;
+}
+
+bool Beeton::transmitMessage(const BeetonAddress &dest, bool reliable, BeetonPriority priority,
+                             bool state, uint16_t thing, uint8_t id, uint8_t action,
+                             const uint8_t *payload, size_t payloadLen) {
+    uint8_t flags = 0;
+    uint16_t seq = 0;
+
     if(reliable){
         flags = BEETON_FLAG_RELIABLE;
+        if(deliveryMode == BEETON_DELIVERY_END_TO_END) {
+            flags |= BEETON_FLAG_E2E;
+        }
         seq = allocSeq();
     }
+    if(priority == BEETON_PRIORITY_URGENT) {
+        flags |= BEETON_FLAG_URGENT;
+    }
     // Build packet ONCE (source of truth)
-    std::vector<uint8_t> packet = buildPacket(flags, seq, thing, id, action, payload);
-    
-    if (lightThread->getRole() == Role::LEADER) {
+    const std::vector<uint8_t> &packet =
+        buildPacket(dest, flags, seq, thing, id, action, payload, payloadLen);
 
+    if(!transmit(dest, packet, reliable, seq, thing, id, action, priority)) {
+        return false;
+    }
 
-        String destIp;
+    if(state) {
+        findPending(seq)->state = true;
+        stateSeqs[makeStateKey(thing, id, action)] = seq;
+    }
+    return true;
+}
 
-        if(!getThingOwnerIp(thing, id, destIp)) {
-            logBeeton(BEETON_LOG_WARN, "Beeton: No IP for thing %04X id %u", thing, id);
+bool Beeton::sendState(uint16_t thing, uint8_t id, uint8_t action, uint8_t payloadByte,
+                       BeetonPriority priority) {
+    byteScratch.assign(1, payloadByte);
+    return sendState(thing, id, action, byteScratch, priority);
+}
+
+// The newest value goes out alone under a fresh seq (the receiver may already
+// have seen the old one). Only once it is sent or held does the entry it
+// replaces stop retrying, so a failed send never loses both values.
+bool Beeton::sendState(uint16_t thing, uint8_t id, uint8_t action,
+                       const std::vector<uint8_t> &payload, BeetonPriority priority) {
+    if(!isReady()) {
+        return false;
+    }
+
+    BeetonAddress dest;
+    if(!resolveNextHop(thing, id, dest)) {
+        return false;
+    }
+
+    Pending *old = nullptr;
+    auto last = stateSeqs.find(makeStateKey(thing, id, action));
+    if(last != stateSeqs.end()) {
+        Pending *p = findPending(last->second);
+        if(p && p->state && p->thing == thing && p->id == id && p->action == action) {
+            old = p;
+        }
+    }
+
+    // The new value takes the old one's window slot
+    uint8_t replacing = old && old->dest == dest ? 1 : 0;
+    bool held = priority != BEETON_PRIORITY_URGENT && mustHold(dest, replacing);
+    if(held) {
+        if(holdMessage(dest, true, priority, thing, id, action, payload) != BEETON_SEND_DEFERRED) {
             return false;
         }
+    } else if(!transmitMessage(dest, true, priority, true, thing, id, action, payload.data(),
+                               payload.size())) {
+        return false;
+    }
+
+    if(dropBatchRecord(dest, thing, id, action)) {
+        stats.supersededFrames++;
+    }
+    if(old) {
+        // Its retry deadline goes stale and is skipped by pumpReliable(). A
+        // sent value took its slot; a held one may now be released into it.
+        BeetonAddress oldDest = old->dest;
+        releasePending(old);
+        pendingRemoved(oldDest, held);
+        stats.supersededFrames++;
+    }
+    return true;
+}
+
+// Package all local things into a WHO_AM_I announcement. It also offers the
+// compact header, so it never rides in a batch where the flag would be lost.
+bool Beeton::sendAnnounce() {
+    if(!isReady()) {
+        return false;
+    }
+
+    BeetonAddress dest;
+    if(!resolveNextHop(BEETON_LEADER_THING, BEETON_LEADER_ID, dest)) {
+        return false;
+    }
 
-        bool ok = lightThread->sendUdp(destIp, packet);
-
-        // Track pending if we requested ACK
-        if (ok && reliable) {
-            Pending p;
-            p.destIp = destIp;
-            p.originIp = lightThread->getMyIp();
-            p.thing = thing; p.id = id; p.action = action;
-            p.payload = payload;
-            p.seq = seq;
-            p.timeoutMs = BEETON_RETRY_INTERVAL_MS;
-            p.retriesLeft = BEETON_MAX_RETRIES;
-            p.nextDueMs = millis() + p.timeoutMs;
-            pending[seq] = std::move(p);
+    std::vector<uint8_t> payload;
+    for(const auto &entry : localThings) {
+        logBeeton(BEETON_LOG_INFO, "Joiner adding thing id: %04X:%d", entry.thing, entry.id);
+        appendUint16(payload, entry.thing);
+        payload.push_back(entry.id);
+    }
+
+    flushBatchTo(dest);
+    uint16_t seq = allocSeq();
+    const std::vector<uint8_t> &packet =
+        buildPacket(dest, BEETON_FLAG_RELIABLE | BEETON_FLAG_COMPACT_CAPABLE, seq, BEETON_LEADER_THING,
+                    BEETON_LEADER_ID, BEETON_LEADER_ACTION_ANNOUNCE, payload.data(), payload.size());
+
+    return transmit(dest, packet, true, seq, BEETON_LEADER_THING, BEETON_LEADER_ID,
+                    BEETON_LEADER_ACTION_ANNOUNCE);
+}
+
+// Leader sends straight to the owner; joiners always go through the leader
+bool Beeton::resolveNextHop(uint16_t thing, uint8_t id, BeetonAddress &dest) {
+    if (lightThread->getRole() == Role::LEADER) {
+        const Node *owner = findThingOwner(thing, id);
+        if(!owner) {
+            logBeeton(BEETON_LOG_WARN, "Beeton: No IP for thing %04X id %u", thing, id);
+            return false;
         }
-        return ok;
-    }
-    else if (lightThread->getRole() == Role::JOINER) {
-        // Send to leader; leader forwards (must preserve packet as-is)
-        bool ok = lightThread->sendUdp(lightThread->getLeaderIp(), packet);
-
-        if (ok && reliable) {
-            Pending p;
-            p.destIp = lightThread->getLeaderIp();      // first hop is leader
-            p.originIp = lightThread->getMyIp();
-            p.thing = thing; p.id = id; p.action = action;
-            p.payload = payload;
-            p.seq = seq;
-            p.timeoutMs = BEETON_RETRY_INTERVAL_MS;
-            p.retriesLeft = BEETON_MAX_RETRIES;
-            p.nextDueMs = millis() + p.timeoutMs;
-            pending[seq] = std::move(p);
+        dest = owner->address;
+        return true;
+    }
+
+    if (lightThread->getRole() == Role::JOINER) {
+        if(leaderAddress.isUnspecified()) {
+            refreshLocalAddresses();
         }
-        return ok;
+        dest = leaderAddress;
+        return !dest.isUnspecified();
     }
 
     logBeeton(BEETON_LOG_WARN, "Beeton: Unknown role, cannot send");
     return false;
 }
 
+bool Beeton::transmit(const BeetonAddress &dest, const std::vector<uint8_t> &frame, bool reliable,
+                      uint16_t seq, uint16_t thing, uint8_t id, uint8_t action,
+                      BeetonPriority priority) {
+    Pending *p = nullptr;
+
+    // Claim the pending slot and its frame block before anything goes out,
+    // so an exhausted pool never leaves an untracked reliable frame behind
+    if(reliable) {
+        p = pending.acquire();
+        BeetonFrame copy = p ? frames.acquire(frame.data(), frame.size()) : BeetonFrame();
+        if(!copy.valid()) {
+            if(p) {
+                pending.release(p);
+                stats.framePoolExhausted++;
+            } else {
+                stats.pendingPoolExhausted++;
+            }
+            logBeeton(BEETON_LOG_WARN, "Beeton: no room to track seq=%u (%u bytes)", seq,
+                      unsigned(frame.size()));
+            return false;
+        }
+        p->frame = copy;
+    }
+
+    bool ok = queueFrame(dest, frame, priority);
+
+    // Track pending if we requested ACK
+    if(p && !ok) {
+        releasePending(p);
+    } else if(p) {
+        p->dest = dest;      // first hop (leader, when sent by a joiner)
+        p->thing = thing; p->id = id; p->action = action;
+        p->seq = seq;
+        pendingBySeq.insert(seq, pending.slotOf(p));
+        p->sentMs = millis();
+        p->timeoutMs = retryTimeoutFor(dest);
+        p->retriesLeft = BEETON_MAX_RETRIES;
+        p->priority = priority;
+        p->nextDueMs = p->sentMs + p->timeoutMs;
+        scheduleRetry(seq, p->nextDueMs);
+        flows[dest].inFlight++;
+    }
+    return ok;
+}
+
+Beeton::Pending *Beeton::findPending(uint16_t seq) {
+    uint16_t slot = pendingBySeq.find(seq);
+    return slot == BeetonFlatMap::NONE ? nullptr : pending.at(slot);
+}
+
+// Frees the slot but not the frame block, which callers may still read
+void Beeton::untrackPending(Pending *p) {
+    uint16_t slot = pending.slotOf(p);
+    if(pendingBySeq.find(p->seq) == slot) {
+        pendingBySeq.erase(p->seq);
+    }
+    pending.release(p);
+}
+
+void Beeton::releasePending(Pending *p) {
+    frames.release(p->frame);
+    untrackPending(p);
+}
+
+// Whether a reliable frame of this size can be tracked right now
+bool Beeton::canTrackReliable(size_t frameLen) {
+    return !pending.full() && frames.canHold(frameLen);
+}
+
+// Urgent frames go out at once. The rest also do while nothing of equal or
+// higher priority is waiting and this update's budget lasts; past that they
+// queue for pumpTx().
+bool Beeton::queueFrame(const BeetonAddress &dest, const std::vector<uint8_t> &frame,
+                        BeetonPriority priority) {
+    return queueFrame(dest, frame.data(), frame.size(), priority);
+}
+
+bool Beeton::queueFrame(const BeetonAddress &dest, const uint8_t *frame, size_t frameLen,
+                        BeetonPriority priority) {
+    BeetonTxClassStats &cls = stats.tx[priority];
+
+    if(priority == BEETON_PRIORITY_URGENT ||
+       ((txBudget == 0 || txCredits > 0) && !hasTxBacklog(priority))) {
+        if(priority != BEETON_PRIORITY_URGENT) {
+            txCredits = txCredits > 0 ? txCredits - 1 : 0;
+        }
+        cls.sentFrames++;
+        sendScratch.assign(frame, frame + frameLen);
+        return sendFrame(dest, sendScratch);
+    }
+
+    BeetonFrame copy;
+    if(!txQueueFull(priority)) {
+        copy = frames.acquire(frame, frameLen);
+        if(!copy.valid()) {
+            stats.framePoolExhausted++;
+        }
+    }
+    if(!copy.valid()) {
+        cls.droppedFrames++;
+        return false;
+    }
+
+    BeetonRing<TxItem, BEETON_TX_QUEUE_MAX> &queue = txQueues[priority];
+    queue.push({dest, copy, uint32_t(millis())});
+    cls.queueDepth = uint16_t(queue.size());
+    cls.maxQueueDepth = std::max(cls.maxQueueDepth, cls.queueDepth);
+    return true;
+}
+
+bool Beeton::txQueueFull(BeetonPriority priority) {
+    return priority != BEETON_PRIORITY_URGENT && txQueues[priority].full();
+}
+
+bool Beeton::hasTxBacklog(BeetonPriority priority) {
+    for(int cls = BEETON_PRIORITY_URGENT; cls <= priority; cls++) {
+        if(!txQueues[cls].empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Drains queued frames strictly by class until the budget runs out
+void Beeton::pumpTx() {
+    uint32_t now = millis();
+
+    for(int priority = BEETON_PRIORITY_NORMAL; priority < BEETON_PRIORITY_COUNT; priority++) {
+        BeetonRing<TxItem, BEETON_TX_QUEUE_MAX> &queue = txQueues[priority];
+        BeetonTxClassStats &cls = stats.tx[priority];
+
+        while(!queue.empty() && (txBudget == 0 || txCredits > 0)) {
+            if(txBudget != 0) {
+                txCredits--;
+            }
+
+            uint32_t latency = now - queue.front().queuedMs;
+            cls.sentFrames++;
+            cls.totalLatencyMs += latency;
+            cls.maxLatencyMs = std::max(cls.maxLatencyMs, latency);
+
+            sendFrame(queue.front().dest, queue.front().frame);
+            frames.release(queue.front().frame);
+            queue.pop();
+        }
+        cls.queueDepth = uint16_t(queue.size());
+    }
+}
+
+BeetonPriority Beeton::priorityOf(uint8_t flags) {
+    return (flags & BEETON_FLAG_URGENT) ? BEETON_PRIORITY_URGENT : BEETON_PRIORITY_NORMAL;
+}
+
+// Fire the ACK callbacks for a finished entry, once per record of a batch
+void Beeton::reportDelivery(const Pending &p, bool delivered) {
+    const auto &cb = delivered ? ackSuccessCb : ackFailCb;
+    if(!cb) {
+        return;
+    }
+
+    BeetonPacketView frame;
+    if(frame.parse(p.frame.data, p.frame.size) && (frame.flags() & BEETON_FLAG_BATCH)) {
+        BeetonPacketView record;
+        size_t offset = 0;
+        while(frame.nextRecord(offset, record)) {
+            cb(record.thing(), record.id(), record.action(), p.seq);
+        }
+        return;
+    }
+
+    cb(p.thing, p.id, p.action, p.seq);
+}
+
 
 // Provide list of local things this device represents
 void Beeton::defineThings(const std::vector<BeetonThing> &list) {
     localThings.assign(list.begin(), list.end());
+    thingsDefinedInCode = true;
 }
 
-// Construct a packet from components
-std::vector<uint8_t> Beeton::buildPacket(uint8_t flags, uint16_t seq, uint16_t thing, uint8_t id, uint8_t action,
-                                         const std::vector<uint8_t> &payload) {
-    uint8_t version = 1;
-    
-    std::vector<uint8_t> out;
-    //reserve full header 
-    out.reserve(1+BEETON_ORIGIN_IP_SIZE+1+2+2+1+1+payload.size());
-    //[0] Version
-    out.push_back(version);
-    //[1..16] Mesh-Local EID (source IP address)
-    String ip = lightThread->getMyIp();
-    auto origin = parseIpv6(ip);
-    out.insert(out.end(),origin.begin(),origin.end());
-    // [17] flags
-    out.push_back(flags);
-
-    // [18..19] seq
-    appendUint16(out, seq);
-    //[20..21] Thing
-    appendUint16(out, thing);
-    //[22] ID
-    out.push_back(id);
-    //[23] action
-    out.push_back(action);
-
-    //[24..end] Payload
-    out.insert(out.end(), payload.begin(), payload.end());
+// Re-encode the version + origin prefix and cache the leader address
+void Beeton::refreshLocalAddresses() {
+    if(!lightThread) {
+        return;
+    }
+
+    BeetonAddress origin;
+    headerPrefix[0] = BEETON_PROTOCOL_VERSION;
+    headerPrefixValid = parseIpv6(lightThread->getMyIp(), origin);
+    memcpy(headerPrefix + 1, origin.bytes, BEETON_ORIGIN_IP_SIZE);
+
+    // A new address or leader invalidates the short address until the
+    // next WHO_AM_I exchange
+    shortAddress = BEETON_SHORT_ADDRESS_NONE;
+
+    if(lightThread->getRole() == Role::JOINER &&
+       parseIpv6(lightThread->getLeaderIp(), leaderAddress)) {
+        internNode(leaderAddress); // caches its text for sendFrame()
+    }
+}
+
+// Construct a packet from components into the reusable txFrame
+const std::vector<uint8_t> &Beeton::buildPacket(const BeetonAddress &dest, uint8_t flags,
+                                                uint16_t seq, uint16_t thing, uint8_t id,
+                                                uint8_t action, const uint8_t *payload,
+                                                size_t payloadLen) {
+    if(!headerPrefixValid) {
+        refreshLocalAddresses();
+    }
+
+    bool compact = compactHeaderTo(dest);
+    size_t headerSize = compact ? BEETON_COMPACT_HEADER_SIZE : BEETON_HEADER_SIZE;
+
+    std::vector<uint8_t> &out = txFrame;
+    // resize() keeps capacity, so steady-state sends do not reallocate
+    out.resize(headerSize + payloadLen);
+    uint8_t *p = out.data();
+
+    if(compact) {
+        //[0] Version, [1..2] short origin, [3] epoch
+        bool leader = lightThread->getRole() == Role::LEADER;
+        uint16_t origin = leader ? BEETON_SHORT_ADDRESS_LEADER : shortAddress;
+        p[BEETON_OFFSET_VERSION] = BEETON_PROTOCOL_VERSION_COMPACT;
+        p[BEETON_COMPACT_OFFSET_ORIGIN] = uint8_t(origin >> 8);
+        p[BEETON_COMPACT_OFFSET_ORIGIN + 1] = uint8_t(origin);
+        p[BEETON_COMPACT_OFFSET_EPOCH] = leader ? leaderEpoch : shortEpoch;
+    } else {
+        //[0] Version, [1..16] Mesh-Local EID (source IP address)
+        memcpy(p, headerPrefix, BEETON_HEADER_PREFIX_SIZE);
+    }
+
+    // Both layouts continue flags, seq, thing, id, action after the origin
+    uint8_t *h = p + (compact ? BEETON_COMPACT_OFFSET_FLAGS : BEETON_OFFSET_FLAGS);
+    h[0] = flags;
+    h[1] = uint8_t(seq >> 8);
+    h[2] = uint8_t(seq);
+    h[3] = uint8_t(thing >> 8);
+    h[4] = uint8_t(thing);
+    h[5] = id;
+    h[6] = action;
+
+    // Payload follows the header
+    if(payloadLen > 0) {
+        memcpy(p + headerSize, payload, payloadLen);
+    }
     return out;
 }
 
-// Attempt to parse a received packet
-bool Beeton::parsePacket(const std::vector<uint8_t> &raw, BeetonPacket &packet) {
+// The leader speaks compact to joiners that announced it; a joiner only to
+// the leader, once it holds a short address.
+bool Beeton::compactHeaderTo(const BeetonAddress &dest) {
+    if(!lightThread) {
+        return false;
+    }
+
+    if(lightThread->getRole() == Role::LEADER) {
+        auto it = nodeIndex.find(dest);
+        return it != nodeIndex.end() && nodes[it->second].compact;
+    }
+
+    return shortAddress != BEETON_SHORT_ADDRESS_NONE && dest == leaderAddress;
+}
+
+size_t Beeton::headerSizeTo(const BeetonAddress &dest) {
+    return compactHeaderTo(dest) ? BEETON_COMPACT_HEADER_SIZE : BEETON_HEADER_SIZE;
+}
+
+// Compact frames only travel between the leader and a joiner, so the short
+// origin is either a node handle + 1 (on the leader) or the leader itself.
+// A handle only holds for the leader epoch it was assigned in.
+bool Beeton::resolveCompactOrigin(BeetonPacketView &packet) {
+    uint16_t origin = packet.originShort();
+
+    if(lightThread->getRole() == Role::LEADER) {
+        if(packet.originEpoch() != leaderEpoch || origin == BEETON_SHORT_ADDRESS_LEADER ||
+           origin > nodes.size()) {
+            return false;
+        }
+        packet.setOrigin(nodes[origin - 1].address);
+        return true;
+    }
 
-    if (raw.size() < BEETON_HEADER_SIZE){
+    if(origin != BEETON_SHORT_ADDRESS_LEADER || leaderAddress.isUnspecified()) {
         return false;
-    }    
-
-    size_t off = 0;
-    //[0] version
-    packet.version = raw[off++];
-    //[1..16] Origin IPv6
-    std::vector<uint8_t> origin(raw.begin() + off, raw.begin() + off + BEETON_ORIGIN_IP_SIZE);
-    off += BEETON_ORIGIN_IP_SIZE;
-    packet.originIp = formatIpv6(origin);
-    // [17] flags
-    packet.flags = raw[off++];
-    // [18..19] seq
-    packet.seq = readUint16(raw, off);
-    off += 2;
-    //[20..21] Thing ID (Big Endian)
-    packet.thing = readUint16(raw, off);
-    off += 2;
-    //[22] ID
-    packet.id = raw[off++];
-    //[23] Action
-    packet.action = raw[off++];
-    //[24..end] Payload
-    packet.payload.assign(raw.begin() + off, raw.end());
+    }
+    packet.setOrigin(leaderAddress);
     return true;
 }
 
-void Beeton::handlePacket(const std::vector<uint8_t> &raw, const BeetonPacket &packet) {
+void Beeton::encodeV1Header(const BeetonAddress &origin, uint8_t flags, uint16_t seq,
+                            uint16_t thing, uint8_t id, uint8_t action, std::vector<uint8_t> &out) {
+    out.resize(BEETON_HEADER_SIZE);
+    uint8_t *p = out.data();
+
+    p[BEETON_OFFSET_VERSION] = BEETON_PROTOCOL_VERSION;
+    memcpy(p + BEETON_OFFSET_ORIGIN, origin.bytes, BEETON_ORIGIN_IP_SIZE);
+    p[BEETON_OFFSET_FLAGS] = flags;
+    p[BEETON_OFFSET_SEQ] = uint8_t(seq >> 8);
+    p[BEETON_OFFSET_SEQ + 1] = uint8_t(seq);
+    p[BEETON_OFFSET_THING] = uint8_t(thing >> 8);
+    p[BEETON_OFFSET_THING + 1] = uint8_t(thing);
+    p[BEETON_OFFSET_ID] = id;
+    p[BEETON_OFFSET_ACTION] = action;
+}
+
+const std::vector<uint8_t> &Beeton::relayFrame(const std::vector<uint8_t> &raw,
+                                               const BeetonPacketView &packet) {
+    if(!packet.compact()) {
+        return raw;
+    }
+
+    // The next hop cannot resolve the sender's short address
+    encodeV1Header(packet.origin(), packet.flags(), packet.seq(), packet.thing(), packet.id(),
+                   packet.action(), relayBuffer);
+    BeetonPayloadView body = packet.payload();
+    relayBuffer.insert(relayBuffer.end(), body.begin(), body.end());
+    return relayBuffer;
+}
+
+void Beeton::handlePacket(const std::vector<uint8_t> &raw, const BeetonPacketView &packet) {
+    if(relayAckIfLeader(raw, packet)) {
+        return;
+    }
+
     if(handleAckPacket(packet)) {
         return;
     }
@@ -235,6 +659,16 @@ void Beeton::handlePacket(const std::vector<uint8_t> &raw, const BeetonPacket &p
         return;
     }
 
+    if(packet.flags() & BEETON_FLAG_BATCH) {
+        handleBatchPacket(raw, packet);
+        return;
+    }
+
+    if(packet.flags() & BEETON_FLAG_GROUP) {
+        handleGroupPacket(packet);
+        return;
+    }
+
     if(handleLeaderControlPacket(packet)) {
         return;
     }
@@ -246,63 +680,320 @@ void Beeton::handlePacket(const std::vector<uint8_t> &raw, const BeetonPacket &p
     dispatchLocalPacket(packet);
 }
 
-bool Beeton::handleAckPacket(const BeetonPacket &packet) {
-    if(!(packet.flags & BEETON_FLAG_ACK)) {
+bool Beeton::handleAckPacket(const BeetonPacketView &packet) {
+    if(!(packet.flags() & BEETON_FLAG_ACK)) {
         return false;
     }
 
-    auto it = pending.find(packet.seq);
+    // Trailing credit byte, after the SACK bitmap when there is one. It
+    // speaks for the window to the next hop only when the next hop sent it;
+    // an end-to-end ACK relayed by the leader carries the owner's credit.
+    BeetonPayloadView body = packet.payload();
+    size_t creditAt = (packet.flags() & BEETON_FLAG_SACK) ? BEETON_SACK_BITMAP_SIZE : 0;
+    if(body.size() > creditAt) {
+        Pending *p = findPending(packet.seq());
+        if(p && packet.origin() == p->dest) {
+            applyCredit(p->dest, body[creditAt]);
+        }
+    }
+
+    retirePending(packet.seq(), true);
+
+    // Selective ACK: retire every older seq the bitmap covers in one go
+    BeetonPayloadView sack = packet.payload();
+    if((packet.flags() & BEETON_FLAG_SACK) && sack.size() >= BEETON_SACK_BITMAP_SIZE) {
+        uint64_t bitmap = 0;
+        for(size_t i = 0; i < BEETON_SACK_BITMAP_SIZE; i++) {
+            bitmap = (bitmap << 8) | sack[i];
+        }
+        for(uint16_t back = 1; back < 64 && (bitmap >> back); back++) {
+            if(bitmap & (uint64_t(1) << back)) {
+                retirePending(uint16_t(packet.seq() - back), false);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Beeton::retirePending(uint16_t seq, bool sampleTiming) {
+    Pending *slot = findPending(seq);
 
-    if(it != pending.end()) {
-        auto p = it->second;
-        pending.erase(it);
-        logBeeton(BEETON_LOG_INFO, "ACK received seq=%u", packet.seq);
-        if(ackSuccessCb) ackSuccessCb(p.thing, p.id, p.action, p.seq);
+    if(!slot) {
+        return false;
     }
 
+    // The copy keeps the frame block until the callbacks have read it
+    Pending p = *slot;
+    untrackPending(slot);
+    pendingRemoved(p.dest, true);
+
+    // Karn: a retransmitted frame gives an ambiguous sample, skip it
+    if(sampleTiming && p.retriesLeft == BEETON_MAX_RETRIES) {
+        sampleRtt(p.dest, millis() - p.sentMs);
+    }
+    logBeeton(BEETON_LOG_INFO, "ACK received seq=%u", seq);
+    reportDelivery(p, true);
+    frames.release(p.frame);
     return true;
 }
 
-bool Beeton::handleReliablePacket(const BeetonPacket &packet) {
-    if(!(packet.flags & BEETON_FLAG_RELIABLE)) {
+bool Beeton::handleReliablePacket(const BeetonPacketView &packet) {
+    if(!(packet.flags() & BEETON_FLAG_RELIABLE)) {
+        return false;
+    }
+
+    // End-to-end frames passing through the leader are ACKed by their owner
+    if((packet.flags() & BEETON_FLAG_E2E) && isRelayedByLeader(packet)) {
         return false;
     }
 
-    if(wasSeenAndMark(packet.originIp, packet.seq, millis())) {
-        logBeeton(BEETON_LOG_INFO, "Duplicate reliable packet seq=%u from %s",
-                  packet.seq, packet.originIp.c_str());
+    BeetonAddress origin = packet.origin();
+    bool viaLeader = ackViaLeader(packet);
+    uint32_t now = millis();
+    SeqCheck check = checkAndMarkSeq(origin, packet.seq(), now);
 
-        auto ack = buildPacket(BEETON_FLAG_ACK, packet.seq, packet.thing, packet.id, packet.action, {});
-        lightThread->sendUdp(packet.originIp, ack);
+    // A node that rebooted within the window's TTL restarts from a random
+    // seq; its first announcement opens a fresh window instead of being lost
+    if(check == SEQ_STALE && startsNewSequence(packet)) {
+        replayWindows.erase(origin);
+        check = checkAndMarkSeq(origin, packet.seq(), now);
+    }
 
+    // Left unACKed, so the sender keeps retrying rather than taking it as delivered
+    if(check == SEQ_STALE) {
+        logBeeton(BEETON_LOG_INFO, "Stale reliable packet seq=%u dropped", packet.seq());
         return true;
     }
 
-    auto ack = buildPacket(BEETON_FLAG_ACK, packet.seq, packet.thing, packet.id, packet.action, {});
-    lightThread->sendUdp(packet.originIp, ack);
+    bool duplicate = check == SEQ_DUPLICATE;
+    if(duplicate) {
+        logBeeton(BEETON_LOG_INFO, "Duplicate reliable packet seq=%u", packet.seq());
+    }
+
+    uint8_t credit = advertisedCredit;
+    size_t creditLen = credit == BEETON_CREDIT_UNADVERTISED ? 0 : 1;
+
+    // Duplicates are ACKed again too: the first ACK was probably lost
+    if(ackMode == BEETON_ACK_DELAYED) {
+        queueDelayedAck(origin, viaLeader, now);
+    } else if(viaLeader) {
+        sendFrame(leaderAddress, buildPacket(leaderAddress, BEETON_FLAG_ACK | BEETON_FLAG_E2E,
+                                             packet.seq(), packet.thing(), packet.id(),
+                                             packet.action(), &credit, creditLen));
+    } else {
+        sendFrame(origin, buildPacket(origin, BEETON_FLAG_ACK, packet.seq(), packet.thing(),
+                                      packet.id(), packet.action(), &credit, creditLen));
+    }
+
+    return duplicate;
+}
+
+// Frames a node sends first after booting: a joiner's WHO_AM_I to the leader,
+// and the leader's short address assignment carrying a new epoch
+bool Beeton::startsNewSequence(const BeetonPacketView &packet) {
+    if(!isLeaderAddress(packet)) {
+        return false;
+    }
+    if(lightThread->getRole() == Role::LEADER) {
+        return packet.action() == BEETON_LEADER_ACTION_ANNOUNCE;
+    }
+    return packet.action() == BEETON_LEADER_ACTION_ASSIGN_SHORT && packet.origin() == leaderAddress &&
+           packet.payload().size() >= 3 && packet.payload()[2] != shortEpoch;
+}
 
+// A joiner owning an end-to-end frame from another joiner answers via the leader
+bool Beeton::ackViaLeader(const BeetonPacketView &packet) {
+    return (packet.flags() & BEETON_FLAG_E2E) && lightThread->getRole() == Role::JOINER &&
+           !leaderAddress.isUnspecified() &&
+           memcmp(leaderAddress.bytes, packet.originBytes(), BEETON_ORIGIN_IP_SIZE) != 0;
+}
+
+bool Beeton::isRelayedByLeader(const BeetonPacketView &packet) {
+    if(lightThread->getRole() != Role::LEADER || isLeaderAddress(packet)) {
+        return false;
+    }
+
+    if(packet.flags() & BEETON_FLAG_GROUP) {
+        return groupHasRemoteOwner(packet);
+    }
+    if(packet.flags() & BEETON_FLAG_BATCH) {
+        return batchHasRemoteOwner(packet);
+    }
+
+    const Node *dest = findThingOwner(packet.thing(), packet.id());
+    return dest && memcmp(dest->address.bytes, packet.originBytes(), BEETON_ORIGIN_IP_SIZE) != 0;
+}
+
+void Beeton::recordRelay(uint16_t destNode, const BeetonPacketView &packet, bool aggregate) {
+    uint16_t originNode = internNode(packet.origin());
+    uint32_t now = millis();
+
+    // A retry of a frame still in flight refreshes its entry
+    for(RelayEntry &entry : relayEntries) {
+        if(entry.destNode == destNode && entry.originNode == originNode &&
+           entry.seq == packet.seq() && (int32_t)(entry.expiresMs - now) > 0) {
+            entry.expiresMs = now + BEETON_RELAY_STATE_TTL_MS;
+            return;
+        }
+    }
+
+    RelayEntry &entry = relayEntries[relayNext];
+    relayNext = (relayNext + 1) % BEETON_RELAY_STATE_MAX;
+
+    entry.destNode = destNode;
+    entry.originNode = originNode;
+    entry.seq = packet.seq();
+    entry.expiresMs = now + BEETON_RELAY_STATE_TTL_MS;
+    entry.aggregate = aggregate;
+    entry.acked = false;
+}
+
+bool Beeton::hasOutstandingRelay(uint16_t originNode, uint16_t seq, uint32_t nowMs) {
+    for(const RelayEntry &entry : relayEntries) {
+        if(entry.aggregate && !entry.acked && entry.originNode == originNode && entry.seq == seq &&
+           (int32_t)(entry.expiresMs - nowMs) > 0) {
+            return true;
+        }
+    }
     return false;
 }
 
-bool Beeton::handleLeaderControlPacket(const BeetonPacket &packet) {
+// Hand an owner's end-to-end ACK back to the node that originated the frame
+bool Beeton::relayAckIfLeader(const std::vector<uint8_t> &raw, const BeetonPacketView &packet) {
+    if((packet.flags() & (BEETON_FLAG_ACK | BEETON_FLAG_E2E)) != (BEETON_FLAG_ACK | BEETON_FLAG_E2E) ||
+       lightThread->getRole() != Role::LEADER) {
+        return false;
+    }
+
+    auto sender = nodeIndex.find(packet.origin());
+    if(sender == nodeIndex.end()) {
+        return false;
+    }
+
+    uint32_t now = millis();
+    for(RelayEntry &entry : relayEntries) {
+        if(entry.destNode == sender->second && entry.seq == packet.seq() &&
+           (int32_t)(entry.expiresMs - now) > 0) {
+            // A group ACK is held until the last owner has answered
+            if(entry.aggregate) {
+                entry.acked = true;
+                if(hasOutstandingRelay(entry.originNode, entry.seq, now)) {
+                    return true;
+                }
+            }
+            sendFrame(nodes[entry.originNode], relayFrame(raw, packet));
+            return true;
+        }
+    }
+    return false;
+}
+
+void Beeton::setAckMode(BeetonAckMode mode, uint16_t delayMs) {
+    if(mode != BEETON_ACK_DELAYED) {
+        flushDelayedAcks(true);
+    }
+    ackMode = mode;
+    ackDelayMs = delayMs;
+}
+
+void Beeton::queueDelayedAck(const BeetonAddress &origin, bool viaLeader, uint32_t nowMs) {
+    auto it = replayWindows.find(origin);
+    if(it == replayWindows.end()) {
+        return;
+    }
+
+    it->second.ackViaLeader = viaLeader;
+    if(it->second.ackPending) {
+        return;
+    }
+
+    it->second.ackPending = true;
+    ackQueue.push_back({origin, nowMs + ackDelayMs});
+}
+
+// One SACK per origin covers everything its replay window has seen
+void Beeton::flushDelayedAcks(bool force) {
+    uint32_t now = millis();
+    size_t done = 0;
+
+    for(; done < ackQueue.size(); done++) {
+        const AckDue &due = ackQueue[done];
+        if(!force && (int32_t)(now - due.dueMs) < 0) {
+            break;
+        }
+
+        auto it = replayWindows.find(due.origin);
+        if(it == replayWindows.end()) {
+            continue;
+        }
+
+        ReplayWindow &w = it->second;
+        w.ackPending = false;
+
+        uint8_t bitmap[BEETON_SACK_BITMAP_SIZE + 1];
+        for(size_t i = 0; i < BEETON_SACK_BITMAP_SIZE; i++) {
+            bitmap[i] = uint8_t(w.bitmap >> (8 * (BEETON_SACK_BITMAP_SIZE - 1 - i)));
+        }
+        bitmap[BEETON_SACK_BITMAP_SIZE] = advertisedCredit;
+        size_t bitmapLen = BEETON_SACK_BITMAP_SIZE +
+                           (advertisedCredit == BEETON_CREDIT_UNADVERTISED ? 0 : 1);
+        uint8_t flags = BEETON_FLAG_ACK | BEETON_FLAG_SACK;
+        if(w.ackViaLeader) {
+            flags |= BEETON_FLAG_E2E;
+        }
+        const BeetonAddress &dest = w.ackViaLeader ? leaderAddress : due.origin;
+        sendFrame(dest, buildPacket(dest, flags, w.highest, 0, 0, 0, bitmap, bitmapLen));
+    }
+
+    ackQueue.erase(ackQueue.begin(), ackQueue.begin() + done);
+}
+
+bool Beeton::handleLeaderControlPacket(const BeetonPacketView &packet) {
     if(!isLeaderAddress(packet)) {
         return false;
     }
 
+    if(!lightThread) {
+        return false;
+    }
+
+    // The one control action a joiner takes: its short address from the leader
+    if(lightThread->getRole() == Role::JOINER) {
+        if(packet.action() != BEETON_LEADER_ACTION_ASSIGN_SHORT || packet.origin() != leaderAddress ||
+           packet.payload().size() < 3) {
+            return false;
+        }
+        uint16_t assigned = readUint16(packet.payload().data(), 0);
+        uint8_t epoch = packet.payload()[2];
+
+        if(assigned != BEETON_SHORT_ADDRESS_NONE) {
+            shortAddress = assigned;
+            shortEpoch = epoch;
+            logBeeton(BEETON_LOG_INFO, "Leader assigned short address %u", shortAddress);
+        } else if(shortAddress != BEETON_SHORT_ADDRESS_NONE && epoch != shortEpoch) {
+            // The leader restarted since; a refusal in our own epoch is a
+            // late answer to a frame sent before the current assignment
+            logBeeton(BEETON_LOG_INFO, "Leader refused short address %u, announcing again",
+                      shortAddress);
+            dropCompactHeaderTo(leaderAddress);
+        }
+        return true;
+    }
+
     // These internal behaviours only exist on the leader.
-    if(!lightThread || lightThread->getRole() != Role::LEADER) {
+    if(lightThread->getRole() != Role::LEADER) {
         return false;
     }
 
-    switch(packet.action) {
+    switch(packet.action()) {
         case BEETON_LEADER_ACTION_ANNOUNCE:
-            for(size_t i = 0; i + 2 < packet.payload.size(); i += 3) {
-                uint16_t thing = readUint16(packet.payload, i);
-                uint8_t id = packet.payload[i + 2];
-
-                registerThingOwner(thing, id, packet.originIp);
-            }
+            registerThingOwners(packet.payload(), packet.origin());
+            assignShortAddress(packet);
+            return true;
 
+        case BEETON_LEADER_ACTION_DEFINE_GROUP:
+            registerGroupMembers(packet.payload());
             return true;
 
         case BEETON_LEADER_ACTION_SERIAL:
@@ -316,7 +1007,7 @@ bool Beeton::handleLeaderControlPacket(const BeetonPacket &packet) {
     }
 }
 
-bool Beeton::forwardPacketIfLeader(const std::vector<uint8_t> &raw, const BeetonPacket &packet) {
+bool Beeton::forwardPacketIfLeader(const std::vector<uint8_t> &raw, const BeetonPacketView &packet) {
     if(!isReady() || lightThread->getRole() != Role::LEADER) {
         return false;
     }
@@ -325,59 +1016,252 @@ bool Beeton::forwardPacketIfLeader(const std::vector<uint8_t> &raw, const Beeton
         return false;
     }
 
-    String destIp;
+    const Node *dest = findThingOwner(packet.thing(), packet.id());
 
-    if(!getThingOwnerIp(packet.thing, packet.id, destIp)) {
+    if(!dest) {
         logBeeton(BEETON_LOG_WARN,
                   "Leader has no destination for thing=%04X id=%u",
-                  packet.thing,
-                  packet.id);
+                  packet.thing(),
+                  packet.id());
         return false;
     }
 
-
-    if(destIp.equals(packet.originIp)) {
+    if(memcmp(dest->address.bytes, packet.originBytes(), BEETON_ORIGIN_IP_SIZE) == 0) {
         return false;
     }
 
     logBeeton(BEETON_LOG_INFO,
-              "Leader forwarding thing=%04X id=%u action=%u to %s",
-              packet.thing,
-              packet.id,
-              packet.action,
-              destIp.c_str());
+              "Leader forwarding thing=%04X id=%u action=%u",
+              packet.thing(),
+              packet.id(),
+              packet.action());
 
-    lightThread->sendUdp(destIp, raw);
+    queueFrame(dest->address, relayFrame(raw, packet), priorityOf(packet.flags()));
+    stats.forwardedFrames++;
     return true;
 }
 
-void Beeton::dispatchLocalPacket(const BeetonPacket &packet) {
-    if(messageCallback) {
-        messageCallback(packet.thing, packet.id, packet.action, packet.payload);
+// Leader hot path: routes on thing, id and flags alone and relays the
+// original bytes (v1) or a v1 re-encoding (compact). Anything it cannot settle
+// falls through to the full handlePacket() path.
+bool Beeton::fastForwardIfLeader(const std::vector<uint8_t> &raw) {
+    if(!isReady() || lightThread->getRole() != Role::LEADER) {
+        return false;
     }
-}
 
-void Beeton::registerThingOwner(uint16_t thing, uint8_t id, const String &ip){
-    uint32_t key = makeThingIdKey(thing, id);
-    thingIdToIp[key] = ip;
+    const uint8_t *p = raw.data();
+    bool compact = p[BEETON_OFFSET_VERSION] == BEETON_PROTOCOL_VERSION_COMPACT;
+    if(!compact && raw.size() < BEETON_HEADER_SIZE) {
+        return false;
+    }
 
-    logBeeton(BEETON_LOG_INFO,
-              "Registered thing=%04X id=%u at %s",
-              thing, id, ip.c_str());
-}
-bool Beeton::getThingOwnerIp(uint16_t thing, uint8_t id, String &outIp) {
-    uint32_t key = makeThingIdKey(thing, id);
+    // Compact offsets are the v1 ones less the shorter origin
+    size_t shift = compact ? BEETON_OFFSET_FLAGS - BEETON_COMPACT_OFFSET_FLAGS : 0;
+    uint8_t flags = p[BEETON_OFFSET_FLAGS - shift];
+
+    // ACKs are consumed here, batches may need splitting and groups fanning out
+    if(flags & (BEETON_FLAG_ACK | BEETON_FLAG_BATCH | BEETON_FLAG_GROUP)) {
+        return false;
+    }
+
+    uint16_t thing = readUint16(p, BEETON_OFFSET_THING - shift);
+    uint8_t id = p[BEETON_OFFSET_ID - shift];
 
-    auto it = thingIdToIp.find(key);
+    if(thing == BEETON_LEADER_THING && id == BEETON_LEADER_ID) {
+        return false;
+    }
+
+    uint16_t node = thingRoutes.find(makeThingIdKey(thing, id));
+    if(node == BeetonFlatMap::NONE) {
+        return false;
+    }
 
-    if(it == thingIdToIp.end()) {
+    if(compact ? readUint16(p, BEETON_COMPACT_OFFSET_ORIGIN) == node + 1
+               : memcmp(nodes[node].address.bytes, p + BEETON_OFFSET_ORIGIN, BEETON_ORIGIN_IP_SIZE) == 0) {
         return false;
     }
 
-    outIp = it->second;
+    BeetonPacketView packet;
+    if(compact || (flags & BEETON_FLAG_RELIABLE)) {
+        packet.parse(p, raw.size());
+        if(compact && !resolveCompactOrigin(packet)) {
+            return false;
+        }
+    }
+
+    if(flags & BEETON_FLAG_RELIABLE) {
+        if(flags & BEETON_FLAG_E2E) {
+            // The owner ACKs and dedupes; every retry has to reach it
+            recordRelay(node, packet);
+        } else if(handleReliablePacket(packet)) {
+            // ACKs the hop; a duplicate origin/seq is re-ACKed but not relayed again
+            return true;
+        }
+    }
+
+    // Indexed late: recordRelay() may intern the origin and grow nodes
+    queueFrame(nodes[node].address, compact ? relayFrame(raw, packet) : raw, priorityOf(flags));
+    stats.forwardedFrames++;
     return true;
 }
 
+void Beeton::dispatchLocalPacket(const BeetonPacketView &packet) {
+    deliverLocal(packet.thing(), packet.id(), packet.action(), packet.payload());
+}
+
+uint16_t Beeton::internNode(const BeetonAddress &address) {
+    auto it = nodeIndex.find(address);
+    if(it != nodeIndex.end()) {
+        return it->second;
+    }
+
+    char ip[BEETON_IPV6_TEXT_BUFFER_SIZE];
+    formatIpv6(address, ip, sizeof(ip));
+
+    uint16_t handle = uint16_t(nodes.size());
+    nodes.push_back({address, String(ip)});
+    nodeIndex[address] = handle;
+    return handle;
+}
+
+// WHO_AM_I payload is a list of [thing hi, thing lo, id] triples
+void Beeton::registerThingOwners(const BeetonPayloadView &announce, const BeetonAddress &owner) {
+    uint16_t handle = internNode(owner);
+    thingRoutes.reserve(thingRoutes.size() + announce.size() / 3);
+
+    for(size_t i = 0; i + 2 < announce.size(); i += 3) {
+        uint16_t thing = readUint16(announce.data(), i);
+        uint8_t id = announce[i + 2];
+
+        thingRoutes.insert(makeThingIdKey(thing, id), handle);
+
+        logBeeton(BEETON_LOG_INFO,
+                  "Registered thing=%04X id=%u at %s",
+                  thing, id, nodes[handle].ipText.c_str());
+    }
+}
+
+// Joiners that can parse compact headers get their short address back
+void Beeton::assignShortAddress(const BeetonPacketView &announce) {
+    uint16_t handle = internNode(announce.origin());
+    Node &node = nodes[handle];
+
+    node.compact = (announce.flags() & BEETON_FLAG_COMPACT_CAPABLE) &&
+                   handle + 1 < BEETON_SHORT_ADDRESS_NONE;
+    if(!node.compact) {
+        return;
+    }
+
+    uint16_t shortOrigin = handle + 1;
+    uint8_t payload[3] = {uint8_t(shortOrigin >> 8), uint8_t(shortOrigin), leaderEpoch};
+    uint16_t seq = allocSeq();
+    const std::vector<uint8_t> &packet =
+        buildPacket(node.address, BEETON_FLAG_RELIABLE, seq, BEETON_LEADER_THING, BEETON_LEADER_ID,
+                    BEETON_LEADER_ACTION_ASSIGN_SHORT, payload, sizeof(payload));
+
+    transmit(node.address, packet, true, seq, BEETON_LEADER_THING, BEETON_LEADER_ID,
+             BEETON_LEADER_ACTION_ASSIGN_SHORT);
+}
+
+// A compact frame whose short origin we cannot resolve. The leader answers
+// with an ASSIGN_SHORT of NONE so the sender announces again; a joiner just
+// drops it, as the leader falls back to v1 when its retries go unanswered.
+void Beeton::refuseCompactOrigin(const String &srcIp, const BeetonPacketView &packet) {
+    logBeeton(BEETON_LOG_WARN, "Unknown short origin %u (epoch %u) from %s", packet.originShort(),
+              packet.originEpoch(), srcIp.c_str());
+
+    BeetonAddress sender;
+    if(lightThread->getRole() != Role::LEADER || !parseIpv6(srcIp, sender)) {
+        return;
+    }
+
+    uint8_t payload[3] = {uint8_t(BEETON_SHORT_ADDRESS_NONE >> 8), uint8_t(BEETON_SHORT_ADDRESS_NONE),
+                          leaderEpoch};
+    const std::vector<uint8_t> &refusal =
+        buildPacket(sender, 0, 0, BEETON_LEADER_THING, BEETON_LEADER_ID,
+                    BEETON_LEADER_ACTION_ASSIGN_SHORT, payload, sizeof(payload));
+    queueFrame(sender, refusal, BEETON_PRIORITY_NORMAL);
+}
+
+// Stops using compact headers towards dest until the next WHO_AM_I exchange.
+// A joiner announces again at once to get a fresh short address.
+void Beeton::dropCompactHeaderTo(const BeetonAddress &dest) {
+    if(lightThread->getRole() == Role::LEADER) {
+        auto it = nodeIndex.find(dest);
+        if(it != nodeIndex.end()) {
+            nodes[it->second].compact = false;
+        }
+        return;
+    }
+
+    if(shortAddress == BEETON_SHORT_ADDRESS_NONE || dest != leaderAddress) {
+        return;
+    }
+    shortAddress = BEETON_SHORT_ADDRESS_NONE;
+    sendAnnounce();
+}
+
+// Compact frames are sent under a short address the peer may since have lost.
+// One retried BEETON_COMPACT_FALLBACK_RETRIES times stops compact headers on
+// the link, and any compact frame whose stamp is no longer current is
+// re-encoded the way buildPacket() would now send it.
+void Beeton::refreshRetryHeader(Pending &p) {
+    const uint8_t *f = p.frame.data;
+    if(f[BEETON_OFFSET_VERSION] != BEETON_PROTOCOL_VERSION_COMPACT) {
+        return;
+    }
+
+    if(BEETON_MAX_RETRIES - p.retriesLeft >= BEETON_COMPACT_FALLBACK_RETRIES) {
+        dropCompactHeaderTo(p.dest);
+    }
+
+    bool leader = lightThread->getRole() == Role::LEADER;
+    uint16_t origin = leader ? BEETON_SHORT_ADDRESS_LEADER : shortAddress;
+    uint8_t epoch = leader ? leaderEpoch : shortEpoch;
+    if(compactHeaderTo(p.dest) && readUint16(f, BEETON_COMPACT_OFFSET_ORIGIN) == origin &&
+       f[BEETON_COMPACT_OFFSET_EPOCH] == epoch) {
+        return;
+    }
+
+    BeetonPacketView packet;
+    packet.parse(f, p.frame.size);
+    BeetonPayloadView body = packet.payload();
+    const std::vector<uint8_t> &frame = buildPacket(p.dest, packet.flags(), packet.seq(), packet.thing(),
+                                                    packet.id(), packet.action(), body.data(), body.size());
+    BeetonFrame copy = frames.acquire(frame.data(), frame.size());
+    if(!copy.valid()) {
+        stats.framePoolExhausted++;
+        return;
+    }
+    frames.release(p.frame);
+    p.frame = copy;
+}
+
+const Beeton::Node *Beeton::findThingOwner(uint16_t thing, uint8_t id) {
+    uint16_t handle = thingRoutes.find(makeThingIdKey(thing, id));
+    return handle == BeetonFlatMap::NONE ? nullptr : &nodes[handle];
+}
+
+bool Beeton::sendFrame(const Node &dest, const std::vector<uint8_t> &frame) {
+    return lightThread->sendUdp(dest.ipText, frame);
+}
+
+bool Beeton::sendFrame(const BeetonAddress &dest, const std::vector<uint8_t> &frame) {
+    auto it = nodeIndex.find(dest);
+    if(it != nodeIndex.end()) {
+        return sendFrame(nodes[it->second], frame);
+    }
+
+    char ip[BEETON_IPV6_TEXT_BUFFER_SIZE];
+    formatIpv6(dest, ip, sizeof(ip));
+    return lightThread->sendUdp(String(ip), frame);
+}
+
+bool Beeton::sendFrame(const BeetonAddress &dest, const BeetonFrame &frame) {
+    sendScratch.assign(frame.data, frame.data + frame.size);
+    return sendFrame(dest, sendScratch);
+}
+
 bool Beeton::isReady(){
     if(!lightThread){
         return false;    
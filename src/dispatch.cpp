@@ -0,0 +1,68 @@
+#include "Beeton.h"
+// Per thing/id/action handler table for locally delivered messages
+
+void Beeton::onAction(uint16_t thing, uint8_t id, uint8_t action, MessageCallback handler) {
+    ActionHandler &entry = actionHandlerFor(thing, id, action);
+    entry.fn = nullptr;
+    entry.context = nullptr;
+    setActionCallback(entry, std::move(handler));
+}
+
+void Beeton::onAction(uint16_t thing, uint8_t id, uint8_t action, ActionFunction fn,
+                      void *context) {
+    ActionHandler &entry = actionHandlerFor(thing, id, action);
+    entry.fn = fn;
+    entry.context = context;
+    setActionCallback(entry, nullptr);
+}
+
+// A handler may re-register its own key, so the std::function it is running
+// from is only overwritten once every call into it has returned
+void Beeton::setActionCallback(ActionHandler &entry, MessageCallback callback) {
+    if(entry.running > 0) {
+        entry.replacement = std::move(callback);
+        entry.replaced = true;
+        return;
+    }
+    entry.callback = std::move(callback);
+}
+
+// Slots are never removed, so a cleared handler is reused if registered again
+Beeton::ActionHandler &Beeton::actionHandlerFor(uint16_t thing, uint8_t id, uint8_t action) {
+    uint32_t key = makeStateKey(thing, id, action);
+    uint16_t index = actionRoutes.find(key);
+
+    if(index == BeetonFlatMap::NONE) {
+        index = uint16_t(actionHandlers.size());
+        actionHandlers.emplace_back();
+        actionRoutes.insert(key, index);
+    }
+    return actionHandlers[index];
+}
+
+void Beeton::deliverLocal(uint16_t thing, uint8_t id, uint8_t action,
+                          const BeetonPayloadView &payload) {
+    uint16_t index = actionRoutes.find(makeStateKey(thing, id, action));
+
+    if(index != BeetonFlatMap::NONE) {
+        ActionHandler &entry = actionHandlers[index];
+        if(entry.fn) {
+            entry.fn(entry.context, thing, id, action, payload);
+            return;
+        }
+        if(entry.callback) {
+            entry.running++;
+            entry.callback(thing, id, action, payload);
+            if(--entry.running == 0 && entry.replaced) {
+                entry.callback = std::move(entry.replacement);
+                entry.replacement = nullptr;
+                entry.replaced = false;
+            }
+            return;
+        }
+    }
+
+    if(messageCallback) {
+        messageCallback(thing, id, action, payload);
+    }
+}
@@ -0,0 +1,100 @@
+#include "Beeton.h"
+// Per-destination window of in-flight reliable messages, plus receiver credit
+
+void Beeton::setFlowControl(uint8_t window, uint8_t maxHeld) {
+    flowWindow = window;
+    flowHeldMax = maxHeld;
+}
+
+// A credit of 0 still lets one message through, so a fresh ACK can reopen the
+// window. replacing counts in-flight messages the caller is about to retire.
+bool Beeton::windowOpen(const BeetonAddress &dest, uint8_t replacing) {
+    auto it = flows.find(dest);
+    if(it == flows.end()) {
+        return true;
+    }
+
+    const Flow &flow = it->second;
+    uint8_t limit = flowWindow == 0 ? UINT8_MAX : flowWindow;
+    if(flow.credit != BEETON_CREDIT_UNADVERTISED) {
+        limit = std::min<uint8_t>(limit, std::max<uint8_t>(flow.credit, 1));
+    }
+    return flow.inFlight - std::min(flow.inFlight, replacing) < limit;
+}
+
+BeetonSendResult Beeton::holdMessage(const BeetonAddress &dest, bool state, BeetonPriority priority,
+                                     uint16_t thing, uint8_t id, uint8_t action,
+                                     const std::vector<uint8_t> &payload) {
+    std::deque<HeldMessage> &held = flows[dest].held;
+
+    // A held state value is simply replaced by the newer one
+    if(state) {
+        for(HeldMessage &m : held) {
+            if(m.state && m.thing == thing && m.id == id && m.action == action) {
+                m.payload = payload;
+                stats.supersededFrames++;
+                return BEETON_SEND_DEFERRED;
+            }
+        }
+    }
+
+    if(held.size() >= flowHeldMax) {
+        return BEETON_SEND_QUEUE_FULL;
+    }
+
+    held.push_back({state, priority, thing, id, action, payload});
+    return BEETON_SEND_DEFERRED;
+}
+
+void Beeton::pendingRemoved(const BeetonAddress &dest, bool release) {
+    auto it = flows.find(dest);
+    if(it == flows.end()) {
+        return;
+    }
+
+    if(it->second.inFlight > 0) {
+        it->second.inFlight--;
+    }
+    if(release) {
+        releaseHeld(dest);
+    }
+}
+
+// Held messages leave in order, as plain frames, while the window has room
+void Beeton::releaseHeld(const BeetonAddress &dest) {
+    auto it = flows.find(dest);
+    if(it == flows.end()) {
+        return;
+    }
+
+    std::deque<HeldMessage> &held = it->second.held;
+    while(!held.empty() && windowOpen(dest)) {
+        HeldMessage m = std::move(held.front());
+        held.pop_front();
+
+        // Transport or queue refused it: keep our place, update() tries again
+        if(!transmitMessage(dest, true, m.priority, m.state, m.thing, m.id, m.action,
+                            m.payload.data(), m.payload.size())) {
+            held.push_front(std::move(m));
+            return;
+        }
+    }
+}
+
+void Beeton::releaseAllHeld() {
+    for(auto &flow : flows) {
+        if(!flow.second.held.empty()) {
+            releaseHeld(flow.first);
+        }
+    }
+}
+
+// New messages also queue behind held ones, so the order is kept
+bool Beeton::mustHold(const BeetonAddress &dest, uint8_t replacing) {
+    auto it = flows.find(dest);
+    return it != flows.end() && (!it->second.held.empty() || !windowOpen(dest, replacing));
+}
+
+void Beeton::applyCredit(const BeetonAddress &dest, uint8_t credit) {
+    flows[dest].credit = credit;
+}
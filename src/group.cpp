@@ -0,0 +1,245 @@
+#include "Beeton.h"
+// Group addressing: one send for many things, fanned out by the leader
+
+void Beeton::defineGroup(const String &name, uint16_t group, const std::vector<BeetonThing> &members) {
+    nameToGroup[name] = group;
+    groupMembers[group] = members;
+
+    if(isReady() && lightThread->getRole() == Role::JOINER) {
+        sendGroupDefinition(group, members);
+    }
+}
+
+bool Beeton::sendGroup(bool reliable, uint16_t group, uint8_t action) {
+    std::vector<uint8_t> payload; // empty vector
+    return sendGroup(reliable, group, action, payload);
+}
+
+bool Beeton::sendGroup(bool reliable, uint16_t group, uint8_t action,
+                       const std::vector<uint8_t> &payload, BeetonPriority priority) {
+    if(!isReady()) {
+        return false;
+    }
+
+    auto it = groupMembers.find(group);
+    if(it == groupMembers.end()) {
+        logBeeton(BEETON_LOG_WARN, "Beeton: Unknown group %u", group);
+        return false;
+    }
+
+    // Members are fanned out as batch records
+    if(payload.size() > BEETON_BATCH_MAX_RECORD_PAYLOAD) {
+        return false;
+    }
+
+    // The leader owns the routes: one batch per owning node. Each owner gets
+    // the same checks as send(); a closed window holds its member instead.
+    if(lightThread->getRole() == Role::LEADER) {
+        if(txQueueFull(priority)) {
+            return false;
+        }
+
+        bool ok = true;
+        for(const BeetonThing &member : it->second) {
+            const Node *owner = isLocalThing(member.thing, member.id)
+                                    ? nullptr
+                                    : findThingOwner(member.thing, member.id);
+            if(!owner) {
+                continue;
+            }
+
+            if(reliable && !canTrackReliable(headerSizeTo(owner->address) +
+                                             BEETON_BATCH_RECORD_HEADER_SIZE + payload.size())) {
+                if(pending.full()) {
+                    stats.pendingPoolExhausted++;
+                } else {
+                    stats.framePoolExhausted++;
+                }
+                ok = false;
+                continue;
+            }
+
+            if(reliable && priority != BEETON_PRIORITY_URGENT && mustHold(owner->address)) {
+                ok &= holdMessage(owner->address, false, priority, member.thing, member.id, action,
+                                  payload) == BEETON_SEND_DEFERRED;
+                continue;
+            }
+
+            ok &= queueBatchRecord(owner->address, reliable, priority, member.thing, member.id,
+                                   action, payload.data(), payload.size());
+        }
+
+        // Only the batches this group touched; an owner seen twice flushes as a no-op
+        if(!batchingEnabled || priority == BEETON_PRIORITY_URGENT) {
+            for(const BeetonThing &member : it->second) {
+                const Node *owner = findThingOwner(member.thing, member.id);
+                if(owner && !isLocalThing(member.thing, member.id)) {
+                    ok &= flushBatchTo(owner->address);
+                }
+            }
+        }
+        return ok;
+    }
+
+    BeetonAddress dest;
+    if(!resolveNextHop(BEETON_LEADER_THING, BEETON_LEADER_ID, dest)) {
+        return false;
+    }
+    flushBatchTo(dest);
+
+    uint8_t flags = BEETON_FLAG_GROUP;
+    uint16_t seq = 0;
+    if(reliable) {
+        flags |= BEETON_FLAG_RELIABLE;
+        if(deliveryMode == BEETON_DELIVERY_END_TO_END) {
+            flags |= BEETON_FLAG_E2E;
+        }
+        seq = allocSeq();
+    }
+    if(priority == BEETON_PRIORITY_URGENT) {
+        flags |= BEETON_FLAG_URGENT;
+    }
+
+    const std::vector<uint8_t> &packet =
+        buildPacket(dest, flags, seq, group, 0, action, payload.data(), payload.size());
+
+    return transmit(dest, packet, reliable, seq, group, 0, action, priority);
+}
+
+// Same layout as WHO_AM_I, prefixed with the group id
+void Beeton::sendGroupDefinition(uint16_t group, const std::vector<BeetonThing> &members) {
+    std::vector<uint8_t> payload;
+    appendUint16(payload, group);
+    for(const BeetonThing &member : members) {
+        appendUint16(payload, member.thing);
+        payload.push_back(member.id);
+    }
+
+    send(true, BEETON_LEADER_THING, BEETON_LEADER_ID, BEETON_LEADER_ACTION_DEFINE_GROUP, payload);
+}
+
+void Beeton::registerGroupMembers(const BeetonPayloadView &definition) {
+    if(definition.size() < 2) {
+        return;
+    }
+
+    uint16_t group = readUint16(definition.data(), 0);
+    std::vector<BeetonThing> &members = groupMembers[group];
+    members.clear();
+
+    for(size_t i = 2; i + 2 < definition.size(); i += 3) {
+        members.push_back({readUint16(definition.data(), i), definition[i + 2]});
+    }
+
+    logBeeton(BEETON_LOG_INFO, "Registered group=%u with %u members", group, members.size());
+}
+
+bool Beeton::groupHasRemoteOwner(const BeetonPacketView &packet) {
+    auto it = groupMembers.find(packet.thing());
+    if(it == groupMembers.end()) {
+        return false;
+    }
+
+    for(const BeetonThing &member : it->second) {
+        uint16_t node = thingRoutes.find(makeThingIdKey(member.thing, member.id));
+        if(node != BeetonFlatMap::NONE && nodes[node].address != packet.origin()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Beeton::isLocalThing(uint16_t thing, uint8_t id) {
+    for(const BeetonThing &entry : localThings) {
+        if(entry.thing == thing && entry.id == id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Leader side: members are regrouped per owning node into one frame each,
+// keeping the sender's origin and seq so owners dedupe and ACK against it.
+void Beeton::handleGroupPacket(const BeetonPacketView &packet) {
+    if(!isReady() || lightThread->getRole() != Role::LEADER) {
+        logBeeton(BEETON_LOG_WARN, "Group frame for %u reached a joiner", packet.thing());
+        return;
+    }
+
+    auto it = groupMembers.find(packet.thing());
+    if(it == groupMembers.end()) {
+        logBeeton(BEETON_LOG_WARN, "Leader has no members for group %u", packet.thing());
+        return;
+    }
+
+    BeetonPayloadView payload = packet.payload();
+    if(payload.size() > BEETON_BATCH_MAX_RECORD_PAYLOAD) {
+        return;
+    }
+
+    // End-to-end group frames skip handleReliablePacket(), so dedupe here
+    // before delivering our own members
+    bool endToEnd = (packet.flags() & (BEETON_FLAG_RELIABLE | BEETON_FLAG_E2E)) ==
+                        (BEETON_FLAG_RELIABLE | BEETON_FLAG_E2E) &&
+                    isRelayedByLeader(packet);
+    bool duplicate = endToEnd && checkAndMarkSeq(packet.origin(), packet.seq(), millis()) != SEQ_NEW;
+
+    uint8_t flags = packet.flags() & ~BEETON_FLAG_GROUP;
+    batchSplitCount = 0;
+
+    for(const BeetonThing &member : it->second) {
+        if(isLocalThing(member.thing, member.id)) {
+            if(!duplicate) {
+                deliverLocal(member.thing, member.id, packet.action(), payload);
+            }
+            continue;
+        }
+
+        uint16_t node = thingRoutes.find(makeThingIdKey(member.thing, member.id));
+        if(node == BeetonFlatMap::NONE || nodes[node].address == packet.origin()) {
+            continue;
+        }
+
+        BatchSplit *split = nullptr;
+        for(size_t i = 0; i < batchSplitCount; i++) {
+            if(batchSplits[i].node == node) {
+                split = &batchSplits[i];
+                break;
+            }
+        }
+
+        if(!split) {
+            if(batchSplitCount == batchSplits.size()) {
+                batchSplits.emplace_back();
+            }
+            split = &batchSplits[batchSplitCount++];
+            split->node = node;
+            split->recordCount = 0;
+            encodeV1Header(packet.origin(), flags, packet.seq(), member.thing, member.id,
+                           packet.action(), split->frame);
+        }
+
+        appendBatchRecord(split->frame, member.thing, member.id, packet.action(), payload.data(),
+                          payload.size());
+        split->recordCount++;
+    }
+
+    for(size_t i = 0; i < batchSplitCount; i++) {
+        BatchSplit &split = batchSplits[i];
+
+        // A lone member goes out as a plain frame
+        if(split.recordCount == 1) {
+            split.frame.erase(split.frame.begin() + BEETON_HEADER_SIZE,
+                              split.frame.begin() + BEETON_HEADER_SIZE + BEETON_BATCH_RECORD_HEADER_SIZE);
+        } else {
+            split.frame[BEETON_OFFSET_FLAGS] |= BEETON_FLAG_BATCH;
+        }
+
+        if(endToEnd) {
+            recordRelay(split.node, packet, true);
+        }
+
+        queueFrame(nodes[split.node].address, split.frame, priorityOf(packet.flags()));
+        stats.forwardedFrames++;
+    }
+}
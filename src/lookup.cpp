@@ -1,69 +1,77 @@
 #include "Beeton.h"
 // Lookup functions for name ↔ ID mappings
-String Beeton::getThingName(uint16_t thing) {
-    auto it = thingToName.find(thing);
+#ifndef BEETON_NO_NAME_LOOKUP
+const char *Beeton::getThingName(uint16_t thing) {
+    const char *name = symbols.thingName(thing);
 
-    if(it == thingToName.end()) {
+    if(!name) {
         return "unknown";
     }
 
-    return it->second;
+    return name;
 }
 
-String Beeton::getActionName(const String &thingName, uint8_t actionId) {
-    auto thingIt = actionIdToName.find(thingName);
+const char *Beeton::getActionName(uint16_t thing, uint8_t actionId) {
+    const char *name = symbols.actionName(thing, actionId);
 
-    if(thingIt == actionIdToName.end()) {
+    if(!name) {
         return "unknown";
     }
 
-    auto actionIt = thingIt->second.find(actionId);
+    return name;
+}
+
+const char *Beeton::getActionName(const char *thingName, uint8_t actionId) {
+    uint16_t thing;
 
-    if(actionIt == thingIt->second.end()) {
+    if(!symbols.thingId(thingName, strlen(thingName), thing)) {
         return "unknown";
     }
 
-    return actionIt->second;
+    return getActionName(thing, actionId);
 }
 
-bool Beeton::getThingId(const String &name, uint16_t &outThing) {
-    auto it = nameToThing.find(name);
+bool Beeton::getThingId(const char *name, size_t len, uint16_t &outThing) {
+    return symbols.thingId(name, len, outThing);
+}
 
-    if(it == nameToThing.end()) {
+bool Beeton::getActionId(const char *thingName, size_t thingLen, const char *actionName,
+                         size_t actionLen, uint8_t &outAction) {
+    uint16_t thing;
+
+    if(!symbols.thingId(thingName, thingLen, thing)) {
         return false;
     }
 
-    outThing = it->second;
-    return true;
+    return symbols.actionId(thing, actionName, actionLen, outAction);
 }
 
-bool Beeton::getActionId(const String &thingName, const String &actionName, uint8_t &outAction) {
-    auto thingIt = actionNameToId.find(thingName);
+bool Beeton::thingExists(uint16_t thing) {
+    return symbols.thingName(thing) != nullptr;
+}
 
-    if(thingIt == actionNameToId.end()) {
-        return false;
-    }
+bool Beeton::actionExists(uint16_t thing, uint8_t actionId) {
+    return symbols.actionName(thing, actionId) != nullptr;
+}
 
-    auto actionIt = thingIt->second.find(actionName);
+bool Beeton::actionExists(const String &thingName, uint8_t actionId) {
+    uint16_t thing;
 
-    if(actionIt == thingIt->second.end()) {
+    if(!symbols.thingId(thingName.c_str(), thingName.length(), thing)) {
         return false;
     }
 
-    outAction = actionIt->second;
-    return true;
-}
-
-bool Beeton::thingExists(uint16_t thing) {
-    return thingToName.find(thing) != thingToName.end();
+    return actionExists(thing, actionId);
 }
+#endif
 
-bool Beeton::actionExists(const String &thingName, uint8_t actionId) {
-    auto thingIt = actionIdToName.find(thingName);
+bool Beeton::getGroupId(const String &name, uint16_t &outGroup) {
+    auto it = nameToGroup.find(name);
 
-    if(thingIt == actionIdToName.end()) {
+    if(it == nameToGroup.end()) {
         return false;
     }
 
-    return thingIt->second.find(actionId) != thingIt->second.end();
+    outGroup = it->second;
+    return true;
 }
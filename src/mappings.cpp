@@ -1,9 +1,36 @@
 #include "Beeton.h"
 
+#ifndef BEETON_NO_NAME_LOOKUP
 #include <FS.h>
 #include <SD.h>
-// Load .csv mappings for things, actions, and local IDs
-void Beeton::loadMappings(const char *thingsPath, const char *actionsPath, const char *definePath) {
+
+#include "BeetonCsv.h"
+
+// Mapping files are read in 256-byte blocks; rows longer than
+// BEETON_CSV_LINE_MAX are skipped
+typedef BeetonCsvReader<File, 256, BEETON_CSV_LINE_MAX> MappingCsv;
+
+static bool readId(const BeetonCsvField &field, uint32_t max, uint32_t &out) {
+    return field.toUint(out) && out <= max;
+}
+
+// Reads the header at the file's position: true if it was built from these sources
+static bool indexIsCurrent(File &file, const BeetonIndexStamp (&stamps)[BEETON_INDEX_SOURCE_COUNT]) {
+    BeetonIndexHeader header;
+    bool current = file.size() >= sizeof(header) &&
+                   file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                   header.magic == BEETON_INDEX_MAGIC && header.version == BEETON_INDEX_VERSION;
+    for(int i = 0; current && i < BEETON_INDEX_SOURCE_COUNT; i++) {
+        current = header.sources[i] == stamps[i];
+    }
+    return current;
+}
+
+// Load .csv mappings for things, actions, and local IDs. Things, actions and
+// defines come from the binary index beside the CSVs while it is current;
+// otherwise the CSVs are parsed and the index rebuilt.
+void Beeton::loadMappings(const char *thingsPath, const char *actionsPath, const char *definePath,
+                          const char *groupsPath, const char *indexPath) {
     if(!SD.begin()) {
         logBeeton(BEETON_LOG_ERROR, "SD card mount failed!");
         return;
@@ -12,10 +39,243 @@ void Beeton::loadMappings(const char *thingsPath, const char *actionsPath, const
     ensureFileExists(thingsPath);
     ensureFileExists(actionsPath);
     ensureFileExists(definePath);
+    ensureFileExists(groupsPath);
+
+    BeetonIndexStamp stamps[BEETON_INDEX_SOURCE_COUNT];
+    stamps[BEETON_INDEX_THINGS] = fileStamp(thingsPath);
+    stamps[BEETON_INDEX_ACTIONS] = fileStamp(actionsPath);
+    stamps[BEETON_INDEX_DEFINES] = fileStamp(definePath);
+
+    if(!loadMappingIndex(indexPath, stamps)) {
+        BeetonMappingIndexBuilder index;
+        std::vector<BeetonThing> defines;
+        loadThings(thingsPath, symbols, index);
+        loadActions(actionsPath, symbols, index);
+        loadDefines(definePath, symbols, defines, index);
+        if(!thingsDefinedInCode) {
+            localThings.swap(defines);
+        }
+        writeMappingIndex(indexPath, stamps, index);
+    }
+    loadGroups(groupsPath, symbols, nameToGroup, groupMembers);
+}
+
+// The CSVs are parsed into scratch tables and compared with the live ones.
+// Lookups between the edits below only ever see the old or the new entry.
+bool Beeton::reloadMappings(BeetonMappingChanges &changes) {
+    changes = BeetonMappingChanges();
+    File probe = SD.open(BEETON_THINGS_PATH);
+    if(!probe) {
+        logBeeton(BEETON_LOG_ERROR, "Reload: cannot read %s", BEETON_THINGS_PATH);
+        return false;
+    }
+    probe.close();
+
+    BeetonIndexStamp stamps[BEETON_INDEX_SOURCE_COUNT];
+    stamps[BEETON_INDEX_THINGS] = fileStamp(BEETON_THINGS_PATH);
+    stamps[BEETON_INDEX_ACTIONS] = fileStamp(BEETON_ACTIONS_PATH);
+    stamps[BEETON_INDEX_DEFINES] = fileStamp(BEETON_DEFINE_PATH);
+
+    BeetonSymbolTable next;
+    BeetonMappingIndexBuilder index;
+    std::vector<BeetonThing> defines;
+    std::map<String, uint16_t> groupNames;
+    GroupMap groups;
+    loadThings(BEETON_THINGS_PATH, next, index);
+    loadActions(BEETON_ACTIONS_PATH, next, index);
+    loadDefines(BEETON_DEFINE_PATH, next, defines, index);
+    loadGroups(BEETON_GROUPS_PATH, next, groupNames, groups);
+
+    applySymbolChanges(next, changes);
+
+    bool joiner = isReady() && lightThread->getRole() == Role::JOINER;
+    for(const auto &group : groups) {
+        std::vector<BeetonThing> &members = groupMembers[group.first];
+        bool same = members.size() == group.second.size();
+        for(size_t i = 0; same && i < members.size(); i++) {
+            same = members[i].thing == group.second[i].thing && members[i].id == group.second[i].id;
+        }
+        if(!same) {
+            members = group.second;
+            changes.groupsChanged++;
+            if(joiner) {
+                sendGroupDefinition(group.first, members);
+            }
+        }
+    }
+    for(const auto &name : groupNames) {
+        nameToGroup[name.first] = name.second;
+    }
+
+    // Things given to defineThings() are the sketch's, not the CSV's
+    if(!thingsDefinedInCode) {
+        changes.definesChanged = defines.size() != localThings.size();
+        for(size_t i = 0; !changes.definesChanged && i < defines.size(); i++) {
+            changes.definesChanged =
+                defines[i].thing != localThings[i].thing || defines[i].id != localThings[i].id;
+        }
+    }
+    if(changes.definesChanged) {
+        localThings.swap(defines);
+        if(joiner) {
+            sendAnnounce();
+        }
+    }
+
+    // A reload of unchanged files leaves the index alone. Changed tables
+    // rewrite it even under the same stamps, which can miss a quick edit.
+    bool tablesChanged = changes.thingsAdded || changes.thingsRemoved || changes.thingsRenamed ||
+                         changes.actionsAdded || changes.actionsRemoved ||
+                         changes.actionsRenamed || changes.definesChanged;
+    File current = SD.open(BEETON_INDEX_PATH);
+    bool indexCurrent = current && indexIsCurrent(current, stamps);
+    if(current) {
+        current.close();
+    }
+    if(tablesChanged || !indexCurrent) {
+        writeMappingIndex(BEETON_INDEX_PATH, stamps, index);
+    }
+
+    logBeeton(BEETON_LOG_INFO,
+              "Reloaded mappings: things +%u -%u ~%u, actions +%u -%u ~%u, groups ~%u, defines %s",
+              changes.thingsAdded, changes.thingsRemoved, changes.thingsRenamed, changes.actionsAdded,
+              changes.actionsRemoved, changes.actionsRenamed, changes.groupsChanged,
+              changes.definesChanged ? "changed" : "unchanged");
+    return true;
+}
+
+// Removals go first, so a name that moved to another ID is free to rebind.
+// A renamed entry is rebound in place and keeps its actions.
+void Beeton::applySymbolChanges(const BeetonSymbolTable &next, BeetonMappingChanges &changes) {
+    std::vector<uint16_t> removedThings;
+    std::vector<BeetonThing> removedActions;
+
+    symbols.forEachThing([&](uint16_t thing, const char *name) {
+        const char *nextName = next.thingName(thing);
+        if(!nextName) {
+            removedThings.push_back(thing);
+            changes.thingsRemoved++;
+            symbols.forEachAction(thing, [&](uint8_t, const char *) { changes.actionsRemoved++; });
+            return;
+        }
+        if(strcmp(name, nextName) != 0) {
+            changes.thingsRenamed++;
+        }
+        symbols.forEachAction(thing, [&](uint8_t action, const char *actionName) {
+            const char *nextAction = next.actionName(thing, action);
+            if(!nextAction) {
+                removedActions.push_back({thing, action});
+                changes.actionsRemoved++;
+            } else if(strcmp(actionName, nextAction) != 0) {
+                changes.actionsRenamed++;
+            }
+        });
+    });
+
+    for(const BeetonThing &action : removedActions) {
+        symbols.removeAction(action.thing, action.id);
+    }
+    for(uint16_t thing : removedThings) {
+        symbols.removeThing(thing);
+    }
+
+    next.forEachThing([&](uint16_t thing, const char *name) {
+        const char *liveName = symbols.thingName(thing);
+        if(!liveName || strcmp(liveName, name) != 0) {
+            changes.thingsAdded += liveName ? 0 : 1;
+            symbols.addThing(name, strlen(name), thing);
+        }
+        next.forEachAction(thing, [&](uint8_t action, const char *actionName) {
+            const char *liveAction = symbols.actionName(thing, action);
+            if(!liveAction || strcmp(liveAction, actionName) != 0) {
+                changes.actionsAdded += liveAction ? 0 : 1;
+                symbols.addAction(thing, actionName, strlen(actionName), action);
+            }
+        });
+    });
+}
 
-    loadThings(thingsPath);
-    loadActions(actionsPath);
-    loadDefines(definePath);
+BeetonIndexStamp Beeton::fileStamp(const char *path) {
+    BeetonIndexStamp stamp;
+    File file = SD.open(path);
+    if(file) {
+        stamp.size = uint32_t(file.size());
+        stamp.mtime = uint32_t(file.getLastWrite());
+        file.close();
+    }
+    return stamp;
+}
+
+// The whole file is read into one symbol table block and names are used in place
+bool Beeton::loadMappingIndex(const char *path,
+                              const BeetonIndexStamp (&stamps)[BEETON_INDEX_SOURCE_COUNT]) {
+    if(!SD.exists(path)) {
+        return false;
+    }
+    File file = SD.open(path);
+    if(!file) {
+        return false;
+    }
+
+    // Check the stamps first, so a stale index costs one small read
+    size_t size = file.size();
+    if(!indexIsCurrent(file, stamps)) {
+        file.close();
+        return false;
+    }
+
+    uint8_t *image = reinterpret_cast<uint8_t *>(symbols.allocate(size));
+    BeetonMappingIndexView index;
+    bool ok = file.seek(0) && file.read(image, size) == size && index.parse(image, size);
+    file.close();
+    if(!ok) {
+        symbols.clear();
+        logBeeton(BEETON_LOG_WARN, "Mapping index %s is damaged, rebuilding", path);
+        return false;
+    }
+
+    for(size_t i = 0; i < index.thingCount(); i++) {
+        const BeetonIndexThing &t = index.thingAt(i);
+        symbols.bindThing(index.name(t.nameOffset), t.nameLen, t.thing);
+    }
+    for(size_t i = 0; i < index.actionCount(); i++) {
+        const BeetonIndexAction &a = index.actionAt(i);
+        symbols.bindAction(a.thing, index.name(a.nameOffset), a.nameLen, a.action);
+    }
+    for(size_t i = 0; !thingsDefinedInCode && i < index.defineCount(); i++) {
+        localThings.push_back({index.defineAt(i).thing, index.defineAt(i).id});
+    }
+
+    logBeeton(BEETON_LOG_INFO, "Loaded mapping index: %u things, %u actions", unsigned(index.thingCount()),
+              unsigned(index.actionCount()));
+    return true;
+}
+
+// Written to a temporary file first, so a power cut never leaves half an index
+void Beeton::writeMappingIndex(const char *path,
+                               const BeetonIndexStamp (&stamps)[BEETON_INDEX_SOURCE_COUNT],
+                               BeetonMappingIndexBuilder &index) {
+    std::vector<uint8_t> image;
+    if(!index.build(stamps, image)) {
+        logBeeton(BEETON_LOG_WARN, "Mapping names too long to index, using the CSVs");
+        return;
+    }
+
+    String tmpPath = String(path) + ".tmp";
+    File file = SD.open(tmpPath, FILE_WRITE);
+    if(!file) {
+        logBeeton(BEETON_LOG_WARN, "Cannot write mapping index %s", tmpPath.c_str());
+        return;
+    }
+    bool ok = file.write(image.data(), image.size()) == image.size();
+    file.close();
+
+    if(ok && (!SD.exists(path) || SD.remove(path)) && SD.rename(tmpPath.c_str(), path)) {
+        logBeeton(BEETON_LOG_INFO, "Rebuilt mapping index %s (%u bytes)", path, unsigned(image.size()));
+    } else {
+        SD.remove(tmpPath.c_str());
+        logBeeton(BEETON_LOG_WARN, "Cannot write mapping index %s", path);
+    }
 }
 
 void Beeton::ensureFileExists(const char *path) {
@@ -46,76 +306,106 @@ void Beeton::ensureFileExists(const char *path) {
     }
 }
 
-void Beeton::loadThings(const char *path) {
+void Beeton::loadThings(const char *path, BeetonSymbolTable &table, BeetonMappingIndexBuilder &index) {
     File file = SD.open(path);
     if(!file)
         return;
 
-    while(file.available()) {
-        String line = file.readStringUntil('\n');
-        line.trim();
-        line.toLowerCase();
-        if(line.length() == 0 || line.startsWith("#"))
+    MappingCsv csv(file);
+    uint32_t id;
+    while(csv.next()) {
+        if(csv.fieldCount() < 2 || csv.field(0).len == 0 || !readId(csv.field(1), UINT16_MAX, id)) {
+            logBeeton(BEETON_LOG_WARN, "%s:%u: expected thing,id\n", path, unsigned(csv.lineNumber()));
             continue;
-
-        int comma = line.indexOf(',');
-        if(comma > 0) {
-            String name = line.substring(0, comma);
-            uint16_t id = line.substring(comma + 1).toInt();
-            nameToThing[name] = id;
-            thingToName[id] = name;
         }
+        const BeetonCsvField &name = csv.field(0);
+        table.addThing(name.data, name.len, uint16_t(id));
+        index.addThing(uint16_t(id), name.data, name.len);
     }
+    logSkippedRows(path, csv.skippedLines());
     file.close();
 }
 
-void Beeton::loadActions(const char *path) {
+void Beeton::loadActions(const char *path, BeetonSymbolTable &table, BeetonMappingIndexBuilder &index) {
     File file = SD.open(path);
     if(!file)
         return;
 
-    while(file.available()) {
-        String line = file.readStringUntil('\n');
-        line.trim();
-        line.toLowerCase();
-        if(line.length() == 0 || line.startsWith("#"))
+    MappingCsv csv(file);
+    uint32_t id;
+    while(csv.next()) {
+        if(csv.fieldCount() < 3 || csv.field(1).len == 0 || !readId(csv.field(2), UINT8_MAX, id)) {
+            logBeeton(BEETON_LOG_WARN, "%s:%u: expected thing,action,id\n", path,
+                      unsigned(csv.lineNumber()));
             continue;
+        }
+        uint16_t thing;
+        if(!table.thingId(csv.field(0).data, csv.field(0).len, thing)) {
+            logBeeton(BEETON_LOG_WARN, "Action for unknown thing: %s\n", csv.field(0).data);
+            continue;
+        }
+        const BeetonCsvField &name = csv.field(1);
+        table.addAction(thing, name.data, name.len, uint8_t(id));
+        index.addAction(thing, uint8_t(id), name.data, name.len);
+        logBeeton(BEETON_LOG_DEBUG, "Parsed action mapping: %s,%s -> %d\n", csv.field(0).data,
+                  name.data, int(id));
+    }
+    logSkippedRows(path, csv.skippedLines());
+    file.close();
+}
 
-        int first = line.indexOf(',');
-        int second = line.indexOf(',', first + 1);
-        if(first > 0 && second > first) {
-            String thing = line.substring(0, first);
-            String action = line.substring(first + 1, second);
-            uint8_t id = line.substring(second + 1).toInt();
-            actionNameToId[thing][action] = id;
-            actionIdToName[thing][id] = action;
-            logBeeton(BEETON_LOG_INFO, "Parsed action mapping: %s,%s -> %d\n", thing.c_str(),
-                      action.c_str(), id);
+void Beeton::loadDefines(const char *path, const BeetonSymbolTable &table,
+                         std::vector<BeetonThing> &defines, BeetonMappingIndexBuilder &index) {
+    File file = SD.open(path);
+    if(!file)
+        return;
+
+    MappingCsv csv(file);
+    uint32_t id;
+    while(csv.next()) {
+        uint16_t thing;
+        if(csv.fieldCount() >= 2 && readId(csv.field(1), UINT8_MAX, id) &&
+           table.thingId(csv.field(0).data, csv.field(0).len, thing)) {
+            defines.push_back({thing, uint8_t(id)});
+            index.addDefine(thing, uint8_t(id));
         }
     }
+    logSkippedRows(path, csv.skippedLines());
     file.close();
 }
 
-void Beeton::loadDefines(const char *path) {
+// One member per line: group,groupId,thing,id
+void Beeton::loadGroups(const char *path, const BeetonSymbolTable &table,
+                        std::map<String, uint16_t> &names, GroupMap &members) {
     File file = SD.open(path);
     if(!file)
         return;
 
-    while(file.available()) {
-        String line = file.readStringUntil('\n');
-        line.trim();
-        line.toLowerCase();
-        if(line.length() == 0 || line.startsWith("#"))
+    MappingCsv csv(file);
+    uint32_t group, id;
+    while(csv.next()) {
+        if(csv.fieldCount() < 4 || csv.field(0).len == 0 || !readId(csv.field(1), UINT16_MAX, group) ||
+           !readId(csv.field(3), UINT8_MAX, id)) {
+            logBeeton(BEETON_LOG_WARN, "%s:%u: expected group,groupId,thing,id\n", path,
+                      unsigned(csv.lineNumber()));
             continue;
-
-        int comma = line.indexOf(',');
-        if(comma > 0) {
-            String thing = line.substring(0, comma);
-            uint8_t id = line.substring(comma + 1).toInt();
-            if(nameToThing.count(thing)) {
-                localThings.push_back({nameToThing[thing], id});
-            }
         }
+        uint16_t thing;
+        if(!table.thingId(csv.field(2).data, csv.field(2).len, thing)) {
+            logBeeton(BEETON_LOG_WARN, "Group %s: unknown thing %s\n", csv.field(0).data,
+                      csv.field(2).data);
+            continue;
+        }
+        names[csv.field(0).data] = uint16_t(group);
+        members[uint16_t(group)].push_back({thing, uint8_t(id)});
     }
+    logSkippedRows(path, csv.skippedLines());
     file.close();
 }
+
+void Beeton::logSkippedRows(const char *path, size_t count) {
+    if(count > 0) {
+        logBeeton(BEETON_LOG_WARN, "%s: skipped %u over-long lines\n", path, unsigned(count));
+    }
+}
+#endif
@@ -6,16 +6,27 @@ void Beeton::sendAllKnownThingsToUsb() {
     if(!lightThread) {
         return;
     }
-    sendUsb("BEGIN_THINGS");
-    for(const auto &entry : thingIdToIp) {
-        uint32_t key = entry.first;
-        const String &ip = entry.second;
-
-        uint16_t thing = keyToThing(key);
-        uint8_t id = keyToId(key);
-
-        sendUsb("THING %04X:%d", thing, id);
+    if(usbBinary) {
+        usbWriter.begin(BEETON_USB_FRAME_THINGS);
+        usbWriter.append(uint8_t(0));
+        thingRoutes.forEach([this](uint32_t key, uint16_t) {
+            if(usbWriter.room() < 3) {
+                sendUsbFrame();
+                usbWriter.begin(BEETON_USB_FRAME_THINGS);
+                usbWriter.append(uint8_t(0));
+            }
+            usbWriter.appendUint16(keyToThing(key));
+            usbWriter.append(keyToId(key));
+        });
+        usbWriter.set(0, 1);
+        sendUsbFrame();
+        return;
     }
+
+    sendUsb("BEGIN_THINGS");
+    thingRoutes.forEach([this](uint32_t key, uint16_t) {
+        sendUsb("THING %04X:%d", keyToThing(key), keyToId(key));
+    });
     sendUsb("END_THINGS");
 }
 
@@ -26,6 +37,22 @@ void Beeton::sendFileOverUsb(String filename) {
         return;
     }
 
+    // Raw bytes, one full frame at a time; a short frame is the last
+    if(usbBinary) {
+        uint8_t chunk[BEETON_USB_FRAME_MAX_BODY - 1];
+        bool last = false;
+        while(!last) {
+            size_t got = f.read(chunk, sizeof(chunk));
+            last = got < sizeof(chunk);
+            usbWriter.begin(BEETON_USB_FRAME_FILE);
+            usbWriter.append(uint8_t(last));
+            usbWriter.append(chunk, last ? got : sizeof(chunk));
+            sendUsbFrame();
+        }
+        f.close();
+        return;
+    }
+
     sendUsb("BEGIN_FILE,%s", filename.c_str());
     while(f.available()) {
         String line = f.readStringUntil('\n');
@@ -45,15 +72,50 @@ void Beeton::sendUsb(const char *fmt, ...) {
     vsnprintf(buffer, sizeof(buffer), fmt, args);
     va_end(args);
 
+    if(usbBinary) {
+        usbWriter.begin(BEETON_USB_FRAME_TEXT);
+        usbWriter.append(reinterpret_cast<const uint8_t *>(buffer), strlen(buffer));
+        sendUsbFrame();
+        return;
+    }
+
     Serial.print("[USB] ");
     Serial.println(buffer); // for now just output directly
 } 
 
-void Beeton::sendRemoteSerialPacket(const BeetonPacket &packet){
+void Beeton::sendUsbFrame() {
+    size_t len;
+    const uint8_t *wire = usbWriter.finish(len);
+    if(!wire) {
+        logBeeton(BEETON_LOG_WARN, "USB frame over %u bytes dropped", unsigned(BEETON_USB_FRAME_MAX_BODY));
+        return;
+    }
+    Serial.write(wire, len);
+}
+
+void Beeton::sendUsbHello() {
+    usbWriter.begin(BEETON_USB_FRAME_HELLO);
+    usbWriter.append(BEETON_USB_FRAME_VERSION);
+    usbWriter.appendUint16(BEETON_USB_FRAME_MAX_BODY);
+    sendUsbFrame();
+}
+
+void Beeton::sendRemoteSerialPacket(const BeetonPacketView &packet){
+    if(usbBinary) {
+        BeetonPayloadView payload = packet.payload();
+        usbWriter.begin(BEETON_USB_FRAME_REMOTE);
+        usbWriter.append(packet.origin().bytes, BEETON_ORIGIN_IP_SIZE);
+        usbWriter.append(payload.data(), payload.size());
+        sendUsbFrame();
+        return;
+    }
+
+    char origin[BEETON_IPV6_TEXT_BUFFER_SIZE];
+    formatIpv6(packet.origin(), origin, sizeof(origin));
     sendUsb(
         "REMOTE,%s,%s",
-        packet.originIp.c_str(),
-        formatPayload(packet.payload).c_str()
+        origin,
+        formatPayload(packet.payload()).c_str()
     );
 }
 
@@ -83,6 +145,14 @@ void Beeton::updateUsb() {
     while(Serial.available()) {
         char c = Serial.read();
 
+        // Framed messages share the port with console lines
+        if(usbReceiver.push(uint8_t(c))) {
+            if(usbReceiver.ready()) {
+                handleUsbFrame();
+            }
+            continue;
+        }
+
         if(c == '\n' || c == '\r') {
             if(input.length() > 0) {
                 handleUsbLine(input);
@@ -101,6 +171,17 @@ void Beeton::handleUsbLine(String input) {
         return;
     }
 
+    if(input.equalsIgnoreCase("BINARY")) {
+        usbBinary = true;
+        sendUsbHello();
+        return;
+    }
+
+    if(input.equalsIgnoreCase("ASCII")) {
+        usbBinary = false;
+        return;
+    }
+
     if(input.equalsIgnoreCase("GETTHINGS")) {
         sendAllKnownThingsToUsb();
         return;
@@ -119,21 +200,41 @@ void Beeton::handleUsbLine(String input) {
         return;
     }
 
+    // Reply: RELOADED,thingsAdded,thingsRemoved,thingsRenamed,actionsAdded,
+    // actionsRemoved,actionsRenamed,groupsChanged,definesChanged
+    if(input.equalsIgnoreCase("RELOAD")) {
+#ifndef BEETON_NO_NAME_LOOKUP
+        BeetonMappingChanges changes;
+        if(reloadMappings(changes)) {
+            sendUsb("RELOADED,%u,%u,%u,%u,%u,%u,%u,%u", changes.thingsAdded, changes.thingsRemoved,
+                    changes.thingsRenamed, changes.actionsAdded, changes.actionsRemoved,
+                    changes.actionsRenamed, changes.groupsChanged, changes.definesChanged ? 1 : 0);
+        } else {
+            sendUsb("ERROR: Reload failed");
+        }
+#else
+        sendUsb("ERROR: Built without name lookup");
+#endif
+        return;
+    }
+
     if(input.equalsIgnoreCase("PACKETTEST")) {
         std::vector<uint8_t> dummy = {1, 2, 3};
-        auto raw = buildPacket(0, 0, 0x1234, 1, 42, dummy);
+        const std::vector<uint8_t> &raw = buildPacket(BeetonAddress(), 0, 0, 0x1234, 1, 42, dummy.data(), dummy.size());
 
-        BeetonPacket packet;
+        BeetonPacketView packet;
 
-        if(parsePacket(raw, packet)) {
+        if(packet.parse(raw.data(), raw.size())) {
+            char origin[BEETON_IPV6_TEXT_BUFFER_SIZE];
+            formatIpv6(packet.origin(), origin, sizeof(origin));
             sendUsb("origin=%s flags=%u seq=%04X thing=%04X id=%u action=%u len=%u",
-                    packet.originIp.c_str(),
-                    packet.flags,
-                    packet.seq,
-                    packet.thing,
-                    packet.id,
-                    packet.action,
-                    packet.payload.size());
+                    origin,
+                    packet.flags(),
+                    packet.seq(),
+                    packet.thing(),
+                    packet.id(),
+                    packet.action(),
+                    packet.payload().size());
         } else {
             sendUsb("PACKETTEST parse failed");
         }
@@ -143,3 +244,50 @@ void Beeton::handleUsbLine(String input) {
 
     sendUsb("ECHO: %s", input.c_str());
 }
+
+void Beeton::handleUsbFrame() {
+    const uint8_t *body = usbReceiver.body();
+    size_t len = usbReceiver.bodyLen();
+
+    switch(usbReceiver.type()) {
+    case BEETON_USB_FRAME_HELLO:
+        usbBinary = true;
+        sendUsbHello();
+        return;
+
+    case BEETON_USB_FRAME_ASCII:
+        usbBinary = false;
+        return;
+
+    case BEETON_USB_FRAME_SEND:
+        if(len < 5) {
+            sendUsb("ERROR: Usage SEND frame reliable,thing,id,action,payload...");
+            return;
+        }
+        usbPayload.assign(body + 5, body + len);
+        send(body[0] != 0, readUint16(body, 1), body[3], body[4], usbPayload);
+        return;
+
+    case BEETON_USB_FRAME_THINGS:
+        sendAllKnownThingsToUsb();
+        return;
+
+    case BEETON_USB_FRAME_FILE:
+    case BEETON_USB_FRAME_TEXT: {
+        // Bodies are at most BEETON_USB_FRAME_MAX_BODY bytes
+        char text[BEETON_USB_FRAME_MAX_BODY + 1];
+        memcpy(text, body, len);
+        text[len] = '\0';
+        if(usbReceiver.type() == BEETON_USB_FRAME_FILE) {
+            sendFileOverUsb(String(text));
+        } else {
+            handleUsbLine(String(text));
+        }
+        return;
+    }
+
+    default:
+        sendUsb("ERROR: Unknown frame type %u", usbReceiver.type());
+        return;
+    }
+}
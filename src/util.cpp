@@ -1,4 +1,5 @@
 #include "Beeton.h"
+#include <algorithm>
 #include <vector>
 #include <IPAddress.h>
 #include <esp_random.h>
@@ -51,47 +52,48 @@ std::vector<String> Beeton::splitCsv(const String &input) {
     return result;
 }
 
-String Beeton::formatPayload(const std::vector<uint8_t> &payload) {
+// One reserve, then each byte appended as at most four characters
+String Beeton::formatPayload(const BeetonPayloadView &payload) {
     String result;
+    result.reserve(payload.size() * 4);
+    char digits[5];
     for(size_t i = 0; i < payload.size(); ++i) {
-        if(i > 0)
-            result += " ";
-        result += String(payload[i], DEC);
+        snprintf(digits, sizeof(digits), i > 0 ? " %u" : "%u", unsigned(payload[i]));
+        result += digits;
     }
     return result;
-} 
-
+}
 
-std::vector<uint8_t> Beeton::parseIpv6(const String &ip) {
-    std::vector<uint8_t> bytes(BEETON_ORIGIN_IP_SIZE, 0);
 
+bool Beeton::parseIpv6(const String &ip, BeetonAddress &out) {
     IPAddress addr;
 
     if(!addr.fromString(ip)) {
         logBeeton(BEETON_LOG_WARN, "Invalid IPv6 address: %s", ip.c_str());
-        return bytes;
+        out = BeetonAddress();
+        return false;
     }
 
-    for(int i = 0; i < BEETON_ORIGIN_IP_SIZE; i++) {
-        bytes[i] = addr[i];
+    for(size_t i = 0; i < BEETON_ORIGIN_IP_SIZE; i++) {
+        out.bytes[i] = addr[i];
     }
 
-    return bytes;
+    return true;
 }
 
 // Turn 16 bytes back into "xxxx:xxxx:..." compressed form
-String Beeton::formatIpv6(const std::vector<uint8_t> &bytes) {
-    char buf[BEETON_IPV6_TEXT_BUFFER_SIZE];
-    snprintf(buf, sizeof(buf),
+void Beeton::formatIpv6(const BeetonAddress &addr, char *out, size_t outLen) {
+    const uint8_t *bytes = addr.bytes;
+    snprintf(out, outLen,
         "%x:%x:%x:%x:%x:%x:%x:%x",
         (bytes[0]<<8)|bytes[1], (bytes[2]<<8)|bytes[3],
         (bytes[4]<<8)|bytes[5], (bytes[6]<<8)|bytes[7],
         (bytes[8]<<8)|bytes[9], (bytes[10]<<8)|bytes[11],
         (bytes[12]<<8)|bytes[13], (bytes[14]<<8)|bytes[15]);
-    return String(buf);
 }
 
 
+
 uint16_t Beeton::allocSeq() {
     if(retainedSeqMagic != SEQ_MAGIC) {
         retainedSeqMagic = SEQ_MAGIC;
@@ -113,17 +115,132 @@ uint16_t Beeton::allocSeq() {
     return retainedNextSeq;
 }
 
-bool Beeton::wasSeenAndMark(const String& origin, uint16_t seq, uint32_t nowMs) {
-    // simple small dedupe window
-    for (auto &e : seen) {
-        if (e.first.origin == origin && e.first.seq == seq) {
-            e.second = nowMs;
-            return true;
+Beeton::SeqCheck Beeton::checkAndMarkSeq(const BeetonAddress &origin, uint16_t seq, uint32_t nowMs) {
+    static_assert(BEETON_REPLAY_WINDOW <= 64, "replay bitmap is 64 bits wide");
+
+    auto it = replayWindows.find(origin);
+
+    if(it == replayWindows.end()) {
+        if(replayWindows.size() >= BEETON_SEEN_ORIGIN_MAX) {
+            // Full: drop the origin that has been quiet the longest
+            auto oldest = replayWindows.begin();
+            for(auto o = replayWindows.begin(); o != replayWindows.end(); ++o) {
+                if((int32_t)(o->second.lastSeenMs - oldest->second.lastSeenMs) < 0) oldest = o;
+            }
+            replayWindows.erase(oldest);
         }
+        replayWindows[origin] = ReplayWindow{seq, 1, nowMs, false, false};
+        return SEQ_NEW;
+    }
+
+    ReplayWindow &w = it->second;
+    int16_t ahead = int16_t(seq - w.highest);
+    uint16_t behind = uint16_t(-ahead);
+
+    // A long-idle window means the sender may have started a new sequence
+    // (cold boot picks a random start): restart it
+    if(nowMs - w.lastSeenMs > BEETON_SEEN_PACKET_TTL_MS) {
+        w.highest = seq;
+        w.bitmap = 1;
+        w.lastSeenMs = nowMs;
+        return SEQ_NEW;
+    }
+
+    // Too old to tell apart from a replay. Not counted as activity, so a
+    // rebooted sender whose retries go unanswered is heard again once the
+    // window expires; one that announces itself resets it sooner.
+    if(ahead <= 0 && behind >= BEETON_REPLAY_WINDOW) {
+        return SEQ_STALE;
     }
-    if (seen.size() >= BEETON_SEEN_PACKET_MAX) seen.erase(seen.begin());
-    seen.push_back({ SeqKey{origin, seq}, nowMs });
-    return false;
+
+    w.lastSeenMs = nowMs;
+
+    if(ahead > 0) {
+        w.bitmap = ahead >= BEETON_REPLAY_WINDOW ? 0 : w.bitmap << ahead;
+        w.bitmap |= 1;
+        w.highest = seq;
+        return SEQ_NEW;
+    }
+
+    uint64_t bit = uint64_t(1) << behind;
+    if(w.bitmap & bit) {
+        return SEQ_DUPLICATE;
+    }
+    w.bitmap |= bit;
+    return SEQ_NEW;
+}
+
+void Beeton::expireReplayWindows(uint32_t nowMs) {
+    // A full sweep once per TTL keeps idle origins from holding memory
+    if(nowMs - lastReplaySweepMs < BEETON_SEEN_PACKET_TTL_MS) {
+        return;
+    }
+    lastReplaySweepMs = nowMs;
+
+    for(auto it = replayWindows.begin(); it != replayWindows.end();) {
+        if(nowMs - it->second.lastSeenMs > BEETON_SEEN_PACKET_TTL_MS) it = replayWindows.erase(it);
+        else ++it;
+    }
+}
+
+// Heap order for std::push_heap/pop_heap: the earliest (wrap-safe) deadline on top
+bool Beeton::dueLater(const RetryDeadline &a, const RetryDeadline &b) {
+    return (int32_t)(a.dueMs - b.dueMs) > 0;
+}
+
+void Beeton::scheduleRetry(uint16_t seq, uint32_t dueMs) {
+    // Acked entries linger until popped; compact once they dominate the heap.
+    if(retryHeap.size() > 2 * pending.size() + BEETON_RETRY_HEAP_SLACK) {
+        retryHeap.erase(std::remove_if(retryHeap.begin(), retryHeap.end(),
+                                       [this](const RetryDeadline &d) { return isStaleDeadline(d); }),
+                        retryHeap.end());
+        std::make_heap(retryHeap.begin(), retryHeap.end(), dueLater);
+    }
+
+    retryHeap.push_back({dueMs, seq});
+    std::push_heap(retryHeap.begin(), retryHeap.end(), dueLater);
+}
+
+bool Beeton::isStaleDeadline(const RetryDeadline &deadline) {
+    const Pending *p = findPending(deadline.seq);
+    return !p || p->nextDueMs != deadline.dueMs;
+}
+
+uint32_t Beeton::nextDeadlineMs() {
+    while(!retryHeap.empty() && isStaleDeadline(retryHeap.front())) {
+        std::pop_heap(retryHeap.begin(), retryHeap.end(), dueLater);
+        retryHeap.pop_back();
+    }
+
+    for(const auto &queue : txQueues) {
+        if(!queue.empty()) {
+            return 0;
+        }
+    }
+
+    uint32_t now = millis();
+    bool haveDeadline = false;
+    int32_t remaining = INT32_MAX;
+    if(!retryHeap.empty()) {
+        haveDeadline = true;
+        remaining = (int32_t)(retryHeap.front().dueMs - now);
+    }
+    if(!ackQueue.empty()) {
+        haveDeadline = true;
+        remaining = std::min(remaining, (int32_t)(ackQueue.front().dueMs - now));
+    }
+    // Open batches go out once their delay has run
+    for(const auto &batch : batches) {
+        if(!batch.records.empty()) {
+            haveDeadline = true;
+            remaining = std::min(remaining, (int32_t)(batch.openedMs + batchDelayMs - now));
+        }
+    }
+
+    if(!haveDeadline) {
+        return UINT32_MAX;
+    }
+    return remaining > 0 ? uint32_t(remaining) : 0;
 }
 
 void Beeton::pumpReliable() {
@@ -131,39 +248,101 @@ void Beeton::pumpReliable() {
         return;
     }
     uint32_t now = millis();
-    std::vector<uint16_t> done;
 
-    for (auto& kv : pending) {
-        auto &p = kv.second;
-        if ((int32_t)(now - p.nextDueMs) < 0) continue;
+    // Only deadlines that have expired are touched
+    while(!retryHeap.empty()) {
+        RetryDeadline due = retryHeap.front();
+        if((int32_t)(now - due.dueMs) < 0) break;
+
+        std::pop_heap(retryHeap.begin(), retryHeap.end(), dueLater);
+        retryHeap.pop_back();
+
+        if(isStaleDeadline(due)) continue;
+
+        Pending &p = *findPending(due.seq);
 
         if (p.retriesLeft == 0) {
-            if (ackFailCb) ackFailCb(p.thing, p.id, p.action, p.seq);
-            done.push_back(kv.first);
+            Pending failed = p;
+            untrackPending(&p);
+            pendingRemoved(failed.dest, true);
+            // callback may send again, so it runs after the entry is gone
+            reportDelivery(failed, false);
+            frames.release(failed.frame);
             continue;
         }
 
-        // resend same packet bytes (rebuild with same flags/seq)
-        auto raw = buildPacket(BEETON_FLAG_RELIABLE, p.seq, p.thing, p.id, p.action, p.payload);
-        lightThread->sendUdp(p.destIp, raw);
+        // resend the exact bytes of the original transmission, in its own
+        // class, unless its compact header may no longer resolve
+        refreshRetryHeader(p);
+        // A dropped resend still uses up the attempt, but is not counted
+        if(queueFrame(p.dest, p.frame.data, p.frame.size, p.priority)) {
+            stats.retransmittedFrames++;
+            stats.retransmittedBytes += p.frame.size;
+        }
 
         p.retriesLeft--;
-        p.nextDueMs = now + p.timeoutMs;
+        p.timeoutMs = uint16_t(std::min<uint32_t>(uint32_t(p.timeoutMs) * 2, BEETON_RTO_MAX_MS));
+        p.nextDueMs = now + withJitter(p.timeoutMs);
+        scheduleRetry(p.seq, p.nextDueMs);
     }
-    for (auto s : done) pending.erase(s);
 
-    // trim dedupe entries
-    auto it = seen.begin();
-    while (it != seen.end()) {
-        if (now - it->second > BEETON_SEEN_PACKET_TTL_MS) it = seen.erase(it);
-        else ++it;
+    expireReplayWindows(now);
+}
+
+uint16_t Beeton::retryTimeoutFor(const BeetonAddress &dest) {
+    auto it = rttByDest.find(dest);
+    if(it == rttByDest.end()) {
+        return BEETON_RETRY_INTERVAL_MS;
+    }
+    return uint16_t(it->second.rtoMs);
+}
+
+void Beeton::sampleRtt(const BeetonAddress &dest, uint32_t rttMs) {
+    BeetonRttEstimate &e = rttByDest[dest];
+
+    if(e.samples == 0) {
+        e.srttMs = rttMs;
+        e.rttvarMs = rttMs / 2;
+    } else {
+        uint32_t delta = e.srttMs > rttMs ? e.srttMs - rttMs : rttMs - e.srttMs;
+        e.rttvarMs = (3 * e.rttvarMs + delta) / 4;
+        e.srttMs = (7 * e.srttMs + rttMs) / 8;
+    }
+    e.samples++;
+
+    uint32_t rto = e.srttMs + 4 * e.rttvarMs;
+    e.rtoMs = std::min(std::max(rto, BEETON_RTO_MIN_MS), BEETON_RTO_MAX_MS);
+}
+
+// Up to +25% random spread so nodes that lost the same frame do not retry in step
+uint32_t Beeton::withJitter(uint32_t timeoutMs) {
+    uint32_t spread = timeoutMs / 4;
+    return spread ? timeoutMs + esp_random() % (spread + 1) : timeoutMs;
+}
+
+bool Beeton::getRttEstimate(const String &ip, BeetonRttEstimate &out) {
+    BeetonAddress dest;
+    if(!parseIpv6(ip, dest)) {
+        return false;
+    }
+
+    auto it = rttByDest.find(dest);
+    if(it == rttByDest.end()) {
+        return false;
     }
+
+    out = it->second;
+    return true;
 }
 
 uint32_t Beeton::makeThingIdKey(uint16_t thing, uint8_t id) {
     return (uint32_t(thing) << 8) | uint32_t(id);
 }
 
+uint32_t Beeton::makeStateKey(uint16_t thing, uint8_t id, uint8_t action) {
+    return (makeThingIdKey(thing, id) << 8) | action;
+}
+
 uint16_t Beeton::keyToThing(uint32_t key) {
     return uint16_t((key >> 8) & 0xFFFF);
 }
@@ -172,14 +351,16 @@ uint8_t Beeton::keyToId(uint32_t key) {
     return uint8_t(key & 0xFF);
 }
 
-bool Beeton::isLeaderAddress(const BeetonPacket &packet) {
-    return packet.thing == BEETON_LEADER_THING &&
-           packet.id == BEETON_LEADER_ID;
+bool Beeton::isLeaderAddress(const BeetonPacketView &packet) {
+    return packet.thing() == BEETON_LEADER_THING &&
+           packet.id() == BEETON_LEADER_ID;
 }
 
 bool Beeton::isLeaderInternalAction(uint8_t action) {
     return action == BEETON_LEADER_ACTION_ANNOUNCE ||
-           action == BEETON_LEADER_ACTION_SERIAL;
+           action == BEETON_LEADER_ACTION_SERIAL ||
+           action == BEETON_LEADER_ACTION_ASSIGN_SHORT ||
+           action == BEETON_LEADER_ACTION_DEFINE_GROUP;
 }
 
 void Beeton::appendUint16(std::vector<uint8_t> &out, uint16_t value) {
@@ -187,6 +368,6 @@ void Beeton::appendUint16(std::vector<uint8_t> &out, uint16_t value) {
     out.push_back(uint8_t(value & 0xFF));
 }
 
-uint16_t Beeton::readUint16(const std::vector<uint8_t> &data, size_t offset) {
+uint16_t Beeton::readUint16(const uint8_t *data, size_t offset) {
     return (uint16_t(data[offset]) << 8) | uint16_t(data[offset + 1]);
 }
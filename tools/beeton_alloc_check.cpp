@@ -0,0 +1,186 @@
+// Host check that the reliable send -> ACK -> retire cycle stays off the heap.
+// A leader and a joiner run the real library over an in-memory radio; after a
+// warm-up, which pays for the first-use state kept per destination and per
+// state key (flows, stateSeqs, RTT estimates), every further cycle must make
+// zero allocations and have every reliable message ACKed.
+//
+//   g++ -std=gnu++17 -DBEETON_COUNT_ALLOCATIONS -Itools/host -Isrc tools/beeton_alloc_check.cpp $(ls src/*.cpp | grep -v Audio) -o beeton_alloc_check
+//   ./beeton_alloc_check [cycles]        (default 1000)
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <SD.h>
+#include <esp_random.h>
+
+#include "Beeton.h"
+
+#ifndef BEETON_COUNT_ALLOCATIONS
+#error "build with -DBEETON_COUNT_ALLOCATIONS"
+#endif
+
+HardwareSerial Serial;
+SDFS SD;
+
+static unsigned long nowMs = 1000;
+
+unsigned long millis() { return nowMs; }
+unsigned long micros() { return nowMs * 1000; }
+void delay(unsigned long ms) { nowMs += ms; }
+uint32_t esp_random() { return uint32_t(rand()); }
+
+// In-memory radio: datagrams wait in a fixed ring of buffers reserved up
+// front, so the radio itself never allocates once running
+struct HostNode {
+    LightThread radio;
+    Role role;
+    String ip;
+    std::function<void(const String &, const std::vector<uint8_t> &)> receive;
+    std::function<void(const String &, const String &)> joined;
+};
+
+static HostNode hostNodes[2];
+static const String LEADER_IP = "fd00::1";
+static const String JOINER_IP = "fd00::2";
+
+struct Datagram {
+    HostNode *from;
+    HostNode *to;
+    std::vector<uint8_t> bytes;
+};
+
+static constexpr size_t AIR_SLOTS = 64;
+static Datagram air[AIR_SLOTS];
+static size_t airHead = 0;
+static size_t airCount = 0;
+static std::vector<uint8_t> delivered;
+
+static HostNode &nodeOf(LightThread *radio) {
+    return radio == &hostNodes[0].radio ? hostNodes[0] : hostNodes[1];
+}
+
+static HostNode *nodeAt(const String &ip) {
+    // Beeton prints addresses uncompressed, so compare the parsed bytes
+    uint8_t want[16], have[16];
+    if(inet_pton(AF_INET6, ip.c_str(), want) != 1) {
+        return nullptr;
+    }
+    for(HostNode &node : hostNodes) {
+        if(inet_pton(AF_INET6, node.ip.c_str(), have) == 1 && memcmp(want, have, 16) == 0) {
+            return &node;
+        }
+    }
+    return nullptr;
+}
+
+Role LightThread::getRole() { return nodeOf(this).role; }
+String LightThread::getMyIp() { return nodeOf(this).ip; }
+String LightThread::getLeaderIp() { return LEADER_IP; }
+bool LightThread::isReady() { return true; }
+bool LightThread::goDormant() { return true; }
+void LightThread::update() {}
+
+bool LightThread::sendUdp(const String &ip, const std::vector<uint8_t> &data) {
+    HostNode *to = nodeAt(ip);
+    if(!to || airCount == AIR_SLOTS) {
+        return false;
+    }
+    Datagram &d = air[(airHead + airCount++) % AIR_SLOTS];
+    d.from = &nodeOf(this);
+    d.to = to;
+    d.bytes.assign(data.begin(), data.end());
+    return true;
+}
+
+void LightThread::registerUdpReceiveCallback(
+    std::function<void(const String &, const std::vector<uint8_t> &)> cb) {
+    nodeOf(this).receive = std::move(cb);
+}
+
+void LightThread::registerJoinCallback(std::function<void(const String &, const String &)> cb) {
+    nodeOf(this).joined = std::move(cb);
+}
+
+// Delivers until the air is quiet; receivers may send more as they go
+static void deliverAll() {
+    while(airCount > 0) {
+        Datagram &d = air[airHead];
+        airHead = (airHead + 1) % AIR_SLOTS;
+        airCount--;
+        delivered.assign(d.bytes.begin(), d.bytes.end());
+        d.to->receive(d.from->ip, delivered);
+    }
+}
+
+static unsigned acked = 0;
+static unsigned received = 0;
+
+// One round: reliable and state sends both ways, then the ACKs come back
+static bool cycle(Beeton &leader, Beeton &joiner, const std::vector<uint8_t> &payload, uint8_t value) {
+    bool ok = joiner.send(true, BEETON_LEADER_THING, BEETON_LEADER_ID, 2, payload) &&
+              joiner.sendState(BEETON_LEADER_THING, BEETON_LEADER_ID, 3, value) &&
+              leader.send(true, 9, 1, 4, payload);
+    deliverAll();
+    nowMs += 5;
+    leader.update();
+    joiner.update();
+    deliverAll();
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    unsigned cycles = argc > 1 ? unsigned(atoi(argv[1])) : 1000;
+
+    for(auto &datagram : air) {
+        datagram.bytes.reserve(BEETON_FRAME_LARGE_SIZE);
+    }
+    delivered.reserve(BEETON_FRAME_LARGE_SIZE);
+
+    hostNodes[0].role = Role::LEADER;
+    hostNodes[0].ip = LEADER_IP;
+    hostNodes[1].role = Role::JOINER;
+    hostNodes[1].ip = JOINER_IP;
+
+    Beeton *leader = new Beeton;
+    Beeton *joiner = new Beeton;
+    leader->begin(hostNodes[0].radio);
+    joiner->begin(hostNodes[1].radio);
+    joiner->defineThings({{9, 1}});
+    leader->onAckSuccess([](uint16_t, uint8_t, uint8_t, uint16_t) { acked++; });
+    joiner->onAckSuccess([](uint16_t, uint8_t, uint8_t, uint16_t) { acked++; });
+    joiner->onMessage([](uint16_t, uint8_t, uint8_t, const BeetonPayloadView &) { received++; });
+
+    // Joining announces the joiner's things, so the leader can reach thing 9
+    hostNodes[1].joined(JOINER_IP, String());
+    deliverAll();
+
+    std::vector<uint8_t> payload = {1, 2, 3};
+    for(unsigned i = 0; i < 50; i++) {
+        cycle(*leader, *joiner, payload, uint8_t(i));
+    }
+
+    const BeetonStats &stats = joiner->getStats();
+    unsigned ackedBefore = acked;
+    unsigned receivedBefore = received;
+    uint32_t retriesBefore = stats.retransmittedFrames;
+    uint32_t before = beetonAllocationCount();
+
+    bool sent = true;
+    for(unsigned i = 0; i < cycles; i++) {
+        sent = cycle(*leader, *joiner, payload, uint8_t(i)) && sent;
+    }
+
+    uint32_t allocations = beetonAllocationCount() - before;
+    unsigned ackedDelta = acked - ackedBefore;
+    printf("%u cycles: %u allocations, %u ACKs, %u received, %u retries\n", cycles, allocations,
+           ackedDelta, received - receivedBefore, stats.retransmittedFrames - retriesBefore);
+
+    // Three reliable messages per cycle, all ACKed within it
+    bool pass = sent && allocations == 0 && ackedDelta == 3 * cycles;
+    puts(pass ? "PASS" : "FAIL");
+    delete joiner;
+    delete leader;
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+#!/usr/bin/env python3
+"""Generate a compile-time Beeton ID catalogue from the mapping CSVs.
+
+Reads the same all_things.csv / all_actions.csv (and optionally
+all_groups.csv) that Beeton loads from SD at boot and writes a header of
+constexpr IDs, so sketches can send without runtime name lookups:
+
+    python3 tools/beeton_catalogue.py --csv-dir examples/beeton \\
+        -o examples/beeton-joiner-controller/BeetonCatalogue.h
+
+    beeton.send(true, BeetonIds::train::STOP, 1);
+
+A misspelt thing or action is then a compile error. Nodes that use only the
+catalogue can build with BEETON_NO_NAME_LOOKUP to skip loading the runtime maps.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+CPP_KEYWORDS = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break",
+    "case", "catch", "char", "class", "compl", "const", "constexpr", "const_cast", "continue",
+    "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit",
+    "export", "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int", "long",
+    "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or",
+    "or_eq", "private", "protected", "public", "register", "reinterpret_cast", "return", "short",
+    "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template",
+    "this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union",
+    "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq",
+}
+
+
+class CatalogueError(Exception):
+    pass
+
+
+def read_rows(path, columns):
+    """Rows as lists of stripped, lower-cased fields, parsed like Beeton's loaders."""
+    rows = []
+    with open(path, encoding="utf-8") as f:
+        for number, line in enumerate(f, 1):
+            line = line.strip().lower()
+            if not line or line.startswith("#"):
+                continue
+            fields = [field.strip() for field in line.split(",")]
+            if len(fields) != columns or not all(fields):
+                raise CatalogueError(f"{path}:{number}: expected {columns} fields: {line!r}")
+            rows.append((number, fields))
+    return rows
+
+
+def parse_id(path, number, text, limit):
+    # Plain decimal only, as Beeton's loaders read it
+    if not re.fullmatch(r"[0-9]+", text):
+        raise CatalogueError(f"{path}:{number}: {text!r} is not a decimal number")
+    value = int(text, 10)
+    if not 0 <= value <= limit:
+        raise CatalogueError(f"{path}:{number}: {value} is outside 0..{limit}")
+    return value
+
+
+def c_string(name):
+    """Name as a C++ string literal."""
+    escaped = []
+    for ch in name:
+        if ch in '"\\':
+            escaped.append("\\" + ch)
+        elif ord(ch) < 0x20 or ord(ch) == 0x7F:
+            escaped.append(f"\\{ord(ch):03o}")
+        else:
+            escaped.append(ch)
+    return '"' + "".join(escaped) + '"'
+
+
+def identifier(name, upper=False):
+    ident = re.sub(r"[^0-9a-zA-Z_]", "_", name)
+    if upper:
+        ident = ident.upper()
+    if ident[0].isdigit():
+        ident = "_" + ident
+    if ident in CPP_KEYWORDS:
+        ident += "_"
+    return ident
+
+
+def load_things(path):
+    things = {}
+    ids = {}
+    for number, (name, value) in read_rows(path, 2):
+        # 0xFFFF is the leader's control thing
+        thing = parse_id(path, number, value, 0xFFFE)
+        if name in things:
+            raise CatalogueError(f"{path}:{number}: thing {name!r} defined twice")
+        if thing in ids:
+            raise CatalogueError(f"{path}:{number}: thing id {thing} already used by {ids[thing]!r}")
+        things[name] = thing
+        ids[thing] = name
+    return things
+
+
+def load_actions(path, things):
+    actions = {name: {} for name in things}
+    for number, (thing, name, value) in read_rows(path, 3):
+        if thing not in things:
+            raise CatalogueError(f"{path}:{number}: unknown thing {thing!r}")
+        # 0xFC..0xFF are reserved for leader control actions
+        action = parse_id(path, number, value, 0xFB)
+        if name in actions[thing]:
+            raise CatalogueError(f"{path}:{number}: action {thing}.{name} defined twice")
+        if action in actions[thing].values():
+            raise CatalogueError(f"{path}:{number}: action id {action} already used on {thing!r}")
+        actions[thing][name] = action
+    return actions
+
+
+def load_groups(path, things):
+    groups = {}
+    for number, (name, value, thing, _instance) in read_rows(path, 4):
+        if thing not in things:
+            raise CatalogueError(f"{path}:{number}: group {name!r}: unknown thing {thing!r}")
+        group = parse_id(path, number, value, 0xFFFF)
+        if groups.get(name, group) != group:
+            raise CatalogueError(f"{path}:{number}: group {name!r} has two ids")
+        groups[name] = group
+    return groups
+
+
+def check_unique(kind, names):
+    seen = {}
+    for name in names:
+        ident = identifier(name, upper=kind != "thing")
+        if ident in seen:
+            raise CatalogueError(f"{kind}s {seen[ident]!r} and {name!r} both map to {ident}")
+        seen[ident] = name
+
+
+def render(things, actions, groups, sources):
+    out = []
+    out.append("#pragma once")
+    out.append("// Generated by tools/beeton_catalogue.py from " + ", ".join(sources) + ".")
+    out.append("// Do not edit; regenerate when the CSVs change.")
+    out.append("")
+    out.append("#include <Beeton.h>")
+    out.append("")
+    out.append("namespace BeetonIds {")
+
+    # The name tables below can't be empty arrays
+    if not things or not any(actions.values()):
+        raise CatalogueError("no things or no actions defined")
+    check_unique("thing", things)
+    for thing, value in sorted(things.items(), key=lambda kv: kv[1]):
+        check_unique("action", actions[thing])
+        out.append("")
+        out.append(f"namespace {identifier(thing)} {{")
+        out.append(f"constexpr uint16_t THING = {value};")
+        for action, action_id in sorted(actions[thing].items(), key=lambda kv: kv[1]):
+            out.append(f"constexpr BeetonActionId {identifier(action, True)}{{THING, {action_id}}};")
+        out.append(f"}} // namespace {identifier(thing)}")
+
+    if groups:
+        check_unique("group", groups)
+        if "groups" in (identifier(thing) for thing in things):
+            raise CatalogueError("a thing named 'groups' clashes with the group namespace")
+        out.append("")
+        out.append("namespace groups {")
+        for group, value in sorted(groups.items(), key=lambda kv: kv[1]):
+            out.append(f"constexpr uint16_t {identifier(group, True)} = {value};")
+        out.append("} // namespace groups")
+
+    # Name tables, for logging without the runtime maps
+    out.append("")
+    out.append("constexpr BeetonCatalogueThing THINGS[] = {")
+    for thing, value in sorted(things.items(), key=lambda kv: kv[1]):
+        out.append(f"    {{{value}, {c_string(thing)}}},")
+    out.append("};")
+    out.append("")
+    out.append("constexpr BeetonCatalogueAction ACTIONS[] = {")
+    for thing, value in sorted(things.items(), key=lambda kv: kv[1]):
+        for action, action_id in sorted(actions[thing].items(), key=lambda kv: kv[1]):
+            out.append(f"    {{{{{value}, {action_id}}}, {c_string(action)}}},")
+    out.append("};")
+    out.append("")
+    out.append("constexpr const char *thingName(uint16_t thing) {")
+    out.append("    for(const BeetonCatalogueThing &entry : THINGS) {")
+    out.append("        if(entry.thing == thing) {")
+    out.append("            return entry.name;")
+    out.append("        }")
+    out.append("    }")
+    out.append('    return "unknown";')
+    out.append("}")
+    out.append("")
+    out.append("constexpr const char *actionName(uint16_t thing, uint8_t action) {")
+    out.append("    for(const BeetonCatalogueAction &entry : ACTIONS) {")
+    out.append("        if(entry.action.is(thing, action)) {")
+    out.append("            return entry.name;")
+    out.append("        }")
+    out.append("    }")
+    out.append('    return "unknown";')
+    out.append("}")
+    out.append("")
+    out.append("} // namespace BeetonIds")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--csv-dir", default="examples/beeton",
+                        help="folder holding all_things.csv, all_actions.csv, all_groups.csv")
+    parser.add_argument("--things", help="things CSV (default: <csv-dir>/all_things.csv)")
+    parser.add_argument("--actions", help="actions CSV (default: <csv-dir>/all_actions.csv)")
+    parser.add_argument("--groups", help="groups CSV (default: <csv-dir>/all_groups.csv if present)")
+    parser.add_argument("-o", "--output", default="-", help="header to write (default: stdout)")
+    args = parser.parse_args()
+
+    things_path = args.things or os.path.join(args.csv_dir, "all_things.csv")
+    actions_path = args.actions or os.path.join(args.csv_dir, "all_actions.csv")
+    groups_path = args.groups or os.path.join(args.csv_dir, "all_groups.csv")
+    if not args.groups and not os.path.exists(groups_path):
+        groups_path = None
+
+    try:
+        things = load_things(things_path)
+        actions = load_actions(actions_path, things)
+        groups = load_groups(groups_path, things) if groups_path else {}
+        sources = [os.path.basename(p) for p in (things_path, actions_path, groups_path) if p]
+        header = render(things, actions, groups, sources)
+    except (CatalogueError, OSError) as e:
+        print(f"beeton_catalogue: {e}", file=sys.stderr)
+        return 1
+
+    if args.output == "-":
+        sys.stdout.write(header)
+    else:
+        with open(args.output, "w", encoding="utf-8", newline="\n") as f:
+            f.write(header)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,208 @@
+// Host benchmark for the mapping loaders: load time and peak heap for large
+// all_things.csv / all_actions.csv catalogues, comparing the old line-by-line
+// string parse into ordered maps with BeetonCsvReader + BeetonSymbolTable.
+//
+//   g++ -O2 -std=gnu++17 -Isrc tools/beeton_csv_bench.cpp -o beeton_csv_bench
+//   ./beeton_csv_bench [lines]        (default 10000)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <new>
+#include <string>
+
+#include "BeetonCsv.h"
+#include "BeetonSymbols.h"
+
+// Heap accounting: every block carries its size in front of it
+static size_t heapLive = 0;
+static size_t heapPeak = 0;
+static size_t heapAllocs = 0;
+
+static void *countedAlloc(size_t size) {
+    size_t *block = static_cast<size_t *>(malloc(size + sizeof(max_align_t)));
+    if(!block) {
+        throw std::bad_alloc();
+    }
+    *block = size;
+    heapLive += size;
+    heapPeak = std::max(heapPeak, heapLive);
+    heapAllocs++;
+    return reinterpret_cast<char *>(block) + sizeof(max_align_t);
+}
+
+static void countedFree(void *p) {
+    if(p) {
+        size_t *block = reinterpret_cast<size_t *>(static_cast<char *>(p) - sizeof(max_align_t));
+        heapLive -= *block;
+        free(block);
+    }
+}
+
+void *operator new(size_t size) { return countedAlloc(size); }
+void *operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete(void *p, size_t) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t) noexcept { countedFree(p); }
+
+// SD File stand-in: read() pulls raw bytes, like File::read(uint8_t *, size_t)
+struct HostFile {
+    FILE *f;
+    size_t read(uint8_t *buf, size_t len) { return fread(buf, 1, len, f); }
+};
+
+static void writeCatalogue(const char *thingsPath, const char *actionsPath, unsigned lines) {
+    FILE *f = fopen(thingsPath, "w");
+    for(unsigned i = 0; i < lines; i++) {
+        // Mixed case and a space after the comma, as hand-edited files have
+        fprintf(f, i % 2 ? "Thing_%u, %u\n" : "thing_%u,%u\n", i, i + 1);
+    }
+    fclose(f);
+
+    // Ten actions per thing on the first lines/10 things
+    f = fopen(actionsPath, "w");
+    for(unsigned i = 0; i < lines; i++) {
+        fprintf(f, "thing_%u,ACTION_%u,%u\n", i / 10, i % 10, i % 10 + 1);
+    }
+    fclose(f);
+}
+
+// The loaders as they were: one string per line, trimmed and lower-cased,
+// split with substrings, stored in ordered maps both ways
+struct StringLoader {
+    std::map<std::string, uint16_t> nameToThing;
+    std::map<uint16_t, std::string> thingToName;
+    std::map<std::string, std::map<std::string, uint8_t>> actionNameToId;
+    std::map<std::string, std::map<uint8_t, std::string>> actionIdToName;
+
+    static bool readLine(FILE *f, std::string &line) {
+        line.clear();
+        int c;
+        while((c = fgetc(f)) != EOF && c != '\n') {
+            line += char(c);
+        }
+        return c != EOF || !line.empty();
+    }
+
+    static void trimLower(std::string &line) {
+        size_t a = line.find_first_not_of(" \t\r");
+        size_t b = line.find_last_not_of(" \t\r");
+        line = a == std::string::npos ? std::string() : line.substr(a, b - a + 1);
+        for(char &c : line) {
+            c = char(tolower(c));
+        }
+    }
+
+    void load(const char *thingsPath, const char *actionsPath) {
+        FILE *f = fopen(thingsPath, "r");
+        std::string line;
+        while(readLine(f, line)) {
+            trimLower(line);
+            if(line.empty() || line[0] == '#')
+                continue;
+            size_t comma = line.find(',');
+            if(comma != std::string::npos && comma > 0) {
+                std::string name = line.substr(0, comma);
+                uint16_t id = uint16_t(atoi(line.substr(comma + 1).c_str()));
+                nameToThing[name] = id;
+                thingToName[id] = name;
+            }
+        }
+        fclose(f);
+
+        f = fopen(actionsPath, "r");
+        while(readLine(f, line)) {
+            trimLower(line);
+            if(line.empty() || line[0] == '#')
+                continue;
+            size_t first = line.find(',');
+            size_t second = line.find(',', first + 1);
+            if(first != std::string::npos && second != std::string::npos) {
+                std::string thing = line.substr(0, first);
+                std::string action = line.substr(first + 1, second - first - 1);
+                uint8_t id = uint8_t(atoi(line.substr(second + 1).c_str()));
+                actionNameToId[thing][action] = id;
+                actionIdToName[thing][id] = action;
+            }
+        }
+        fclose(f);
+    }
+
+    size_t count() const { return nameToThing.size(); }
+};
+
+struct CsvLoader {
+    BeetonSymbolTable symbols;
+    size_t things = 0;
+
+    void load(const char *thingsPath, const char *actionsPath) {
+        uint32_t id;
+        HostFile file = {fopen(thingsPath, "r")};
+        {
+            BeetonCsvReader<HostFile> csv(file);
+            while(csv.next()) {
+                if(csv.fieldCount() >= 2 && csv.field(1).toUint(id) && id <= UINT16_MAX) {
+                    symbols.addThing(csv.field(0).data, csv.field(0).len, uint16_t(id));
+                    things++;
+                }
+            }
+        }
+        fclose(file.f);
+
+        file.f = fopen(actionsPath, "r");
+        {
+            BeetonCsvReader<HostFile> csv(file);
+            uint16_t thing;
+            while(csv.next()) {
+                if(csv.fieldCount() >= 3 && csv.field(2).toUint(id) && id <= UINT8_MAX &&
+                   symbols.thingId(csv.field(0).data, csv.field(0).len, thing)) {
+                    symbols.addAction(thing, csv.field(1).data, csv.field(1).len, uint8_t(id));
+                }
+            }
+        }
+        fclose(file.f);
+    }
+
+    size_t count() const { return things; }
+};
+
+template <typename Loader> static void run(const char *label, const char *thingsPath, const char *actionsPath) {
+    size_t baseLive = heapLive;
+    heapPeak = heapLive;
+    heapAllocs = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    Loader *loader = new Loader;
+    loader->load(thingsPath, actionsPath);
+    auto end = std::chrono::steady_clock::now();
+
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    printf("%-14s %8.2f ms  peak %8zu B  retained %8zu B  %7zu allocs  (%zu things)\n", label, ms,
+           heapPeak - baseLive, heapLive - baseLive, heapAllocs, loader->count());
+    delete loader;
+}
+
+int main(int argc, char **argv) {
+    unsigned lines = argc > 1 ? unsigned(atoi(argv[1])) : 10000;
+    if(lines == 0 || lines > 65535) {
+        fprintf(stderr, "lines must be 1..65535\n");
+        return 1;
+    }
+
+    const char *thingsPath = "/tmp/beeton_bench_things.csv";
+    const char *actionsPath = "/tmp/beeton_bench_actions.csv";
+    writeCatalogue(thingsPath, actionsPath, lines);
+    printf("%u lines per file\n", lines);
+
+    // Warm the page cache so both loaders read from memory
+    run<StringLoader>("warm-up", thingsPath, actionsPath);
+    run<StringLoader>("string+map", thingsPath, actionsPath);
+    run<CsvLoader>("csv+symbols", thingsPath, actionsPath);
+
+    remove(thingsPath);
+    remove(actionsPath);
+    return 0;
+}
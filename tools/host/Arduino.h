@@ -0,0 +1,101 @@
+#pragma once
+
+// Host stand-ins for the Arduino-ESP32 core, just enough to build src/*.cpp
+// (minus the audio driver) on a PC for tools such as beeton_alloc_check.cpp.
+// Time and the radio are supplied by the tool.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+#define RTC_DATA_ATTR // no deep sleep on a PC; plain static storage
+
+// As with the core's default debug level, only warnings and errors print
+#define log_d(...) ((void)0)
+#define log_i(...) ((void)0)
+#define log_w(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+#define log_e(...) (fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+class String {
+  public:
+    String() = default;
+    String(const char *text) : s(text ? text : "") {}
+    String(const std::string &text) : s(text) {}
+    String(int value) : s(std::to_string(value)) {}
+    String(unsigned value) : s(std::to_string(value)) {}
+
+    const char *c_str() const { return s.c_str(); }
+    unsigned length() const { return unsigned(s.size()); }
+    char operator[](unsigned i) const { return s[i]; }
+    bool reserve(unsigned size) {
+        s.reserve(size);
+        return true;
+    }
+
+    int indexOf(char c, unsigned from = 0) const { return found(s.find(c, from)); }
+    int lastIndexOf(char c) const { return found(s.rfind(c)); }
+    String substring(unsigned from) const { return from > s.size() ? String() : String(s.substr(from)); }
+    String substring(unsigned from, unsigned to) const {
+        return from > s.size() ? String() : String(s.substr(from, to - from));
+    }
+    bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+    bool equalsIgnoreCase(const String &other) const { return strcasecmp(c_str(), other.c_str()) == 0; }
+    long toInt() const { return atol(s.c_str()); }
+
+    void trim() {
+        size_t a = s.find_first_not_of(" \t\r\n");
+        size_t b = s.find_last_not_of(" \t\r\n");
+        s = a == std::string::npos ? std::string() : s.substr(a, b - a + 1);
+    }
+    void toLowerCase() {
+        for(char &c : s) {
+            c = char(tolower(c));
+        }
+    }
+    void remove(unsigned index, unsigned count = 1) { s.erase(index, count); }
+
+    String &operator+=(const String &other) {
+        s += other.s;
+        return *this;
+    }
+    String &operator+=(char c) {
+        s += c;
+        return *this;
+    }
+    bool operator==(const String &other) const { return s == other.s; }
+    bool operator!=(const String &other) const { return s != other.s; }
+    bool operator<(const String &other) const { return s < other.s; }
+
+  private:
+    std::string s;
+
+    static int found(size_t pos) { return pos == std::string::npos ? -1 : int(pos); }
+};
+
+inline String operator+(const String &a, const String &b) {
+    String out = a;
+    out += b;
+    return out;
+}
+inline String operator+(const char *a, const String &b) { return String(a) + b; }
+
+// A quiet console: nothing is read, output is dropped
+struct HardwareSerial {
+    void begin(unsigned long) {}
+    int available() { return 0; }
+    int read() { return -1; }
+    size_t print(const char *) { return 0; }
+    size_t println(const char *) { return 0; }
+    size_t write(const uint8_t *, size_t len) { return len; }
+};
+
+extern HardwareSerial Serial;
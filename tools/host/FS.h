@@ -0,0 +1,23 @@
+#pragma once
+
+// Host stand-in: a File that is always empty
+
+#include <Arduino.h>
+#include <time.h>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+
+class File {
+  public:
+    explicit operator bool() const { return false; }
+    size_t size() { return 0; }
+    time_t getLastWrite() { return 0; }
+    int available() { return 0; }
+    int read() { return -1; }
+    size_t read(uint8_t *, size_t) { return 0; }
+    bool seek(uint32_t) { return false; }
+    size_t write(const uint8_t *, size_t) { return 0; }
+    String readStringUntil(char) { return String(); }
+    void close() {}
+};
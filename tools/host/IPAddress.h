@@ -0,0 +1,15 @@
+#pragma once
+
+// Host stand-in: IPv6 only, parsed by the C library
+
+#include <Arduino.h>
+#include <arpa/inet.h>
+
+class IPAddress {
+  public:
+    bool fromString(const String &text) { return inet_pton(AF_INET6, text.c_str(), bytes) == 1; }
+    uint8_t operator[](int i) const { return bytes[i]; }
+
+  private:
+    uint8_t bytes[16] = {};
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+// Host stand-in for the LightThread radio API; the tool defines the methods
+
+#include <Arduino.h>
+#include <functional>
+#include <vector>
+
+enum class Role { LEADER, JOINER };
+
+class LightThread {
+  public:
+    Role getRole();
+    String getMyIp();
+    String getLeaderIp();
+    bool isReady();
+    bool goDormant();
+    void update();
+    bool sendUdp(const String &ip, const std::vector<uint8_t> &data);
+    void registerUdpReceiveCallback(std::function<void(const String &, const std::vector<uint8_t> &)> cb);
+    void registerJoinCallback(std::function<void(const String &, const String &)> cb);
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+// Host stand-in: a card that is never present, so mappings come from code
+
+#include <FS.h>
+
+struct SDFS {
+    bool begin() { return false; }
+    File open(const String &, const char * = FILE_READ) { return File(); }
+    bool exists(const String &) { return false; }
+    bool mkdir(const String &) { return false; }
+    bool remove(const String &) { return false; }
+    bool rename(const String &, const String &) { return false; }
+};
+
+extern SDFS SD;